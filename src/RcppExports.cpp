@@ -10,13 +10,187 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// circle_index_new
+SEXP circle_index_new(IntegerVector ids, NumericVector xs, NumericVector ys, NumericVector rs);
+RcppExport SEXP _packcircles_circle_index_new(SEXP idsSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP rsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerVector >::type ids(idsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type rs(rsSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_index_new(ids, xs, ys, rs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// circle_index_layout
+DataFrame circle_index_layout(SEXP index);
+RcppExport SEXP _packcircles_circle_index_layout(SEXP indexSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_index_layout(index));
+    return rcpp_result_gen;
+END_RCPP
+}
+// circle_index_hit
+IntegerVector circle_index_hit(SEXP index, NumericVector xs, NumericVector ys);
+RcppExport SEXP _packcircles_circle_index_hit(SEXP indexSEXP, SEXP xsSEXP, SEXP ysSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_index_hit(index, xs, ys));
+    return rcpp_result_gen;
+END_RCPP
+}
+// circle_index_range
+IntegerVector circle_index_range(SEXP index, double xmin, double xmax, double ymin, double ymax);
+RcppExport SEXP _packcircles_circle_index_range(SEXP indexSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< double >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< double >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_index_range(index, xmin, xmax, ymin, ymax));
+    return rcpp_result_gen;
+END_RCPP
+}
+// circle_index_nearest
+IntegerMatrix circle_index_nearest(SEXP index, NumericVector xs, NumericVector ys, int k);
+RcppExport SEXP _packcircles_circle_index_nearest(SEXP indexSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_index_nearest(index, xs, ys, k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// circle_index_move
+void circle_index_move(SEXP index, NumericVector xs, NumericVector ys);
+RcppExport SEXP _packcircles_circle_index_move(SEXP indexSEXP, SEXP xsSEXP, SEXP ysSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    circle_index_move(index, xs, ys);
+    return R_NilValue;
+END_RCPP
+}
+// circle_index_subset
+void circle_index_subset(SEXP index, LogicalVector keep);
+RcppExport SEXP _packcircles_circle_index_subset(SEXP indexSEXP, SEXP keepSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< LogicalVector >::type keep(keepSEXP);
+    circle_index_subset(index, keep);
+    return R_NilValue;
+END_RCPP
+}
+// circle_vertices
+List circle_vertices(NumericVector xc, NumericVector yc, NumericVector radius, int npoints, int nthreads);
+RcppExport SEXP _packcircles_circle_vertices(SEXP xcSEXP, SEXP ycSEXP, SEXP radiusSEXP, SEXP npointsSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type xc(xcSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type yc(ycSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< int >::type npoints(npointsSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(circle_vertices(xc, yc, radius, npoints, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// layout_file_vertices
+double layout_file_vertices(std::string inpath, std::string outpath, int npoints, int nthreads);
+RcppExport SEXP _packcircles_layout_file_vertices(SEXP inpathSEXP, SEXP outpathSEXP, SEXP npointsSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type inpath(inpathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type outpath(outpathSEXP);
+    Rcpp::traits::input_parameter< int >::type npoints(npointsSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(layout_file_vertices(inpath, outpath, npoints, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// layout_file_write
+void layout_file_write(std::string path, NumericVector ids, NumericVector xs, NumericVector ys, NumericVector rs);
+RcppExport SEXP _packcircles_layout_file_write(SEXP pathSEXP, SEXP idsSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP rsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ids(idsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type rs(rsSEXP);
+    layout_file_write(path, ids, xs, ys, rs);
+    return R_NilValue;
+END_RCPP
+}
+// layout_file_rows
+double layout_file_rows(std::string path);
+RcppExport SEXP _packcircles_layout_file_rows(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(layout_file_rows(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// layout_file_read
+DataFrame layout_file_read(std::string path, double from, double count);
+RcppExport SEXP _packcircles_layout_file_read(SEXP pathSEXP, SEXP fromSEXP, SEXP countSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< double >::type count(countSEXP);
+    rcpp_result_gen = Rcpp::wrap(layout_file_read(path, from, count));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_nested_layout
+DataFrame do_nested_layout(IntegerVector parent, NumericVector radii, double padding, int nthreads);
+RcppExport SEXP _packcircles_do_nested_layout(SEXP parentSEXP, SEXP radiiSEXP, SEXP paddingSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerVector >::type parent(parentSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type radii(radiiSEXP);
+    Rcpp::traits::input_parameter< double >::type padding(paddingSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_nested_layout(parent, radii, padding, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // iterate_layout
-int iterate_layout(NumericMatrix xyr, NumericVector weights, double xmin, double xmax, double ymin, double ymax, int maxiter, bool wrap);
-RcppExport SEXP _packcircles_iterate_layout(SEXP xyrSEXP, SEXP weightsSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP, SEXP maxiterSEXP, SEXP wrapSEXP) {
+List iterate_layout(NumericVector xs, NumericVector ys, NumericVector sizes, bool area, NumericVector weights, double xmin, double xmax, double ymin, double ymax, int maxiter, bool wrap, std::string method, int nthreads, double tolerance, bool relative, double stopoverlap, double stopmove, bool single, bool counters, double timelimit, SEXP progress);
+RcppExport SEXP _packcircles_iterate_layout(SEXP xsSEXP, SEXP ysSEXP, SEXP sizesSEXP, SEXP areaSEXP, SEXP weightsSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP, SEXP maxiterSEXP, SEXP wrapSEXP, SEXP methodSEXP, SEXP nthreadsSEXP, SEXP toleranceSEXP, SEXP relativeSEXP, SEXP stopoverlapSEXP, SEXP stopmoveSEXP, SEXP singleSEXP, SEXP countersSEXP, SEXP timelimitSEXP, SEXP progressSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type xyr(xyrSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sizes(sizesSEXP);
+    Rcpp::traits::input_parameter< bool >::type area(areaSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< double >::type xmin(xminSEXP);
     Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
@@ -24,19 +198,60 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
     Rcpp::traits::input_parameter< int >::type maxiter(maxiterSEXP);
     Rcpp::traits::input_parameter< bool >::type wrap(wrapSEXP);
-    rcpp_result_gen = Rcpp::wrap(iterate_layout(xyr, weights, xmin, xmax, ymin, ymax, maxiter, wrap));
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type relative(relativeSEXP);
+    Rcpp::traits::input_parameter< double >::type stopoverlap(stopoverlapSEXP);
+    Rcpp::traits::input_parameter< double >::type stopmove(stopmoveSEXP);
+    Rcpp::traits::input_parameter< bool >::type single(singleSEXP);
+    Rcpp::traits::input_parameter< bool >::type counters(countersSEXP);
+    Rcpp::traits::input_parameter< double >::type timelimit(timelimitSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type progress(progressSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_layout(xs, ys, sizes, area, weights, xmin, xmax, ymin, ymax, maxiter, wrap, method, nthreads, tolerance, relative, stopoverlap, stopmove, single, counters, timelimit, progress));
+    return rcpp_result_gen;
+END_RCPP
+}
+// layout_file_repel
+List layout_file_repel(std::string path, NumericVector weights, double xmin, double xmax, double ymin, double ymax, int maxiter, bool wrap, std::string method, int nthreads, double tolerance, bool relative, double stopoverlap, double stopmove, double timelimit, SEXP progress);
+RcppExport SEXP _packcircles_layout_file_repel(SEXP pathSEXP, SEXP weightsSEXP, SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP, SEXP maxiterSEXP, SEXP wrapSEXP, SEXP methodSEXP, SEXP nthreadsSEXP, SEXP toleranceSEXP, SEXP relativeSEXP, SEXP stopoverlapSEXP, SEXP stopmoveSEXP, SEXP timelimitSEXP, SEXP progressSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< double >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< double >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
+    Rcpp::traits::input_parameter< int >::type maxiter(maxiterSEXP);
+    Rcpp::traits::input_parameter< bool >::type wrap(wrapSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< bool >::type relative(relativeSEXP);
+    Rcpp::traits::input_parameter< double >::type stopoverlap(stopoverlapSEXP);
+    Rcpp::traits::input_parameter< double >::type stopmove(stopmoveSEXP);
+    Rcpp::traits::input_parameter< double >::type timelimit(timelimitSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type progress(progressSEXP);
+    rcpp_result_gen = Rcpp::wrap(layout_file_repel(path, weights, xmin, xmax, ymin, ymax, maxiter, wrap, method, nthreads, tolerance, relative, stopoverlap, stopmove, timelimit, progress));
     return rcpp_result_gen;
 END_RCPP
 }
 // doCirclePack
-List doCirclePack(List internalList, DataFrame externalDF);
-RcppExport SEXP _packcircles_doCirclePack(SEXP internalListSEXP, SEXP externalDFSEXP) {
+List doCirclePack(List internalList, DataFrame externalDF, bool accelerate, int nthreads, bool counters, double timelimit, SEXP progress);
+RcppExport SEXP _packcircles_doCirclePack(SEXP internalListSEXP, SEXP externalDFSEXP, SEXP accelerateSEXP, SEXP nthreadsSEXP, SEXP countersSEXP, SEXP timelimitSEXP, SEXP progressSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< List >::type internalList(internalListSEXP);
     Rcpp::traits::input_parameter< DataFrame >::type externalDF(externalDFSEXP);
-    rcpp_result_gen = Rcpp::wrap(doCirclePack(internalList, externalDF));
+    Rcpp::traits::input_parameter< bool >::type accelerate(accelerateSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type counters(countersSEXP);
+    Rcpp::traits::input_parameter< double >::type timelimit(timelimitSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type progress(progressSEXP);
+    rcpp_result_gen = Rcpp::wrap(doCirclePack(internalList, externalDF, accelerate, nthreads, counters, timelimit, progress));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -51,16 +266,176 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// do_progressive_layout_into
+int do_progressive_layout_into(NumericVector radii, SEXP xs, SEXP ys);
+RcppExport SEXP _packcircles_do_progressive_layout_into(SEXP radiiSEXP, SEXP xsSEXP, SEXP ysSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type radii(radiiSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ys(ysSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_progressive_layout_into(radii, xs, ys));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_progressive_layout_sizes
+DataFrame do_progressive_layout_sizes(NumericVector sizes, bool area, IntegerVector groups, int ngroups, int nthreads, bool counters);
+RcppExport SEXP _packcircles_do_progressive_layout_sizes(SEXP sizesSEXP, SEXP areaSEXP, SEXP groupsSEXP, SEXP ngroupsSEXP, SEXP nthreadsSEXP, SEXP countersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type sizes(sizesSEXP);
+    Rcpp::traits::input_parameter< bool >::type area(areaSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter< int >::type ngroups(ngroupsSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type counters(countersSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_progressive_layout_sizes(sizes, area, groups, ngroups, nthreads, counters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// progressive_stream_new
+SEXP progressive_stream_new();
+RcppExport SEXP _packcircles_progressive_stream_new() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(progressive_stream_new());
+    return rcpp_result_gen;
+END_RCPP
+}
+// progressive_stream_add
+DataFrame progressive_stream_add(SEXP stream, NumericVector sizes, bool area);
+RcppExport SEXP _packcircles_progressive_stream_add(SEXP streamSEXP, SEXP sizesSEXP, SEXP areaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type stream(streamSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sizes(sizesSEXP);
+    Rcpp::traits::input_parameter< bool >::type area(areaSEXP);
+    rcpp_result_gen = Rcpp::wrap(progressive_stream_add(stream, sizes, area));
+    return rcpp_result_gen;
+END_RCPP
+}
+// layout_file_progressive
+double layout_file_progressive(std::string path);
+RcppExport SEXP _packcircles_layout_file_progressive(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(layout_file_progressive(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repel_state_new
+SEXP repel_state_new(double xmin, double xmax, double ymin, double ymax, bool wrap, std::string method, int nthreads);
+RcppExport SEXP _packcircles_repel_state_new(SEXP xminSEXP, SEXP xmaxSEXP, SEXP yminSEXP, SEXP ymaxSEXP, SEXP wrapSEXP, SEXP methodSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type xmin(xminSEXP);
+    Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< double >::type ymin(yminSEXP);
+    Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
+    Rcpp::traits::input_parameter< bool >::type wrap(wrapSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(repel_state_new(xmin, xmax, ymin, ymax, wrap, method, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repel_state_add
+IntegerVector repel_state_add(SEXP state, NumericVector xs, NumericVector ys, NumericVector sizes, bool area, NumericVector ws);
+RcppExport SEXP _packcircles_repel_state_add(SEXP stateSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP sizesSEXP, SEXP areaSEXP, SEXP wsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sizes(sizesSEXP);
+    Rcpp::traits::input_parameter< bool >::type area(areaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ws(wsSEXP);
+    rcpp_result_gen = Rcpp::wrap(repel_state_add(state, xs, ys, sizes, area, ws));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repel_state_remove
+void repel_state_remove(SEXP state, IntegerVector ids);
+RcppExport SEXP _packcircles_repel_state_remove(SEXP stateSEXP, SEXP idsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ids(idsSEXP);
+    repel_state_remove(state, ids);
+    return R_NilValue;
+END_RCPP
+}
+// repel_state_resize
+void repel_state_resize(SEXP state, IntegerVector ids, NumericVector rs);
+RcppExport SEXP _packcircles_repel_state_resize(SEXP stateSEXP, SEXP idsSEXP, SEXP rsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ids(idsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type rs(rsSEXP);
+    repel_state_resize(state, ids, rs);
+    return R_NilValue;
+END_RCPP
+}
+// repel_state_step
+List repel_state_step(SEXP state, int maxiter);
+RcppExport SEXP _packcircles_repel_state_step(SEXP stateSEXP, SEXP maxiterSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< int >::type maxiter(maxiterSEXP);
+    rcpp_result_gen = Rcpp::wrap(repel_state_step(state, maxiter));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repel_state_layout
+DataFrame repel_state_layout(SEXP state);
+RcppExport SEXP _packcircles_repel_state_layout(SEXP stateSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    rcpp_result_gen = Rcpp::wrap(repel_state_layout(state));
+    return rcpp_result_gen;
+END_RCPP
+}
 // select_non_overlapping
-LogicalVector select_non_overlapping(NumericMatrix xyr, const double tolerance, const StringVector& ordering);
-RcppExport SEXP _packcircles_select_non_overlapping(SEXP xyrSEXP, SEXP toleranceSEXP, SEXP orderingSEXP) {
+LogicalVector select_non_overlapping(NumericMatrix xyr, const double tolerance, const StringVector& ordering, const int nthreads, const bool parallel, SEXP index);
+RcppExport SEXP _packcircles_select_non_overlapping(SEXP xyrSEXP, SEXP toleranceSEXP, SEXP orderingSEXP, SEXP nthreadsSEXP, SEXP parallelSEXP, SEXP indexSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< NumericMatrix >::type xyr(xyrSEXP);
     Rcpp::traits::input_parameter< const double >::type tolerance(toleranceSEXP);
     Rcpp::traits::input_parameter< const StringVector& >::type ordering(orderingSEXP);
-    rcpp_result_gen = Rcpp::wrap(select_non_overlapping(xyr, tolerance, ordering));
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type parallel(parallelSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    rcpp_result_gen = Rcpp::wrap(select_non_overlapping(xyr, tolerance, ordering, nthreads, parallel, index));
+    return rcpp_result_gen;
+END_RCPP
+}
+// exact_non_overlapping
+List exact_non_overlapping(NumericMatrix xyr, const double tolerance, NumericVector weights, const int nthreads, SEXP index);
+RcppExport SEXP _packcircles_exact_non_overlapping(SEXP xyrSEXP, SEXP toleranceSEXP, SEXP weightsSEXP, SEXP nthreadsSEXP, SEXP indexSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type xyr(xyrSEXP);
+    Rcpp::traits::input_parameter< const double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type index(indexSEXP);
+    rcpp_result_gen = Rcpp::wrap(exact_non_overlapping(xyr, tolerance, weights, nthreads, index));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -0,0 +1,165 @@
+/*
+ * Uniform grid (cell list) over a set of circle centres.
+ *
+ * Used as a broad phase by the layout and overlap functions: two circles
+ * can only overlap if their centres are closer than the sum of their radii,
+ * so with a cell size of at least twice the largest radius any overlapping
+ * pair lies in the same or adjacent cells.
+ *
+ * Items are stored in compressed form (counting sort by cell), so building
+ * the grid makes two passes over the centres and no per-cell allocation.
+ */
+
+#ifndef PACKCIRCLES_CELL_GRID_H
+#define PACKCIRCLES_CELL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+class CellGrid {
+public:
+  CellGrid() : _ncols(0), _nrows(0), _cellsize(1.0), _x0(0.0), _y0(0.0) {}
+
+  // Builds the grid for n centres with coordinates xs[i], ys[i].
+  // The cell size will be at least min_cellsize, and is increased if
+  // necessary so that the number of cells does not greatly exceed n.
+  // Non-finite coordinates are assigned to the first cell. Coordinates 
+  // may be float or double.
+  //
+  template<typename T>
+  void build(const T* xs, const T* ys, int n, double min_cellsize) {
+    double xlo = INFINITY, xhi = -INFINITY;
+    double ylo = INFINITY, yhi = -INFINITY;
+
+    for (int i = 0; i < n; i++) {
+      if (std::isfinite(xs[i])) {
+        xlo = std::min(xlo, (double) xs[i]);
+        xhi = std::max(xhi, (double) xs[i]);
+      }
+      if (std::isfinite(ys[i])) {
+        ylo = std::min(ylo, (double) ys[i]);
+        yhi = std::max(yhi, (double) ys[i]);
+      }
+    }
+
+    if (xlo > xhi) xlo = xhi = 0.0;
+    if (ylo > yhi) ylo = yhi = 0.0;
+
+    double w = xhi - xlo;
+    double h = yhi - ylo;
+
+    // Limit the number of cells to about 2n
+    double cs = min_cellsize > 0.0 ? min_cellsize : 1.0;
+    const double maxcells = 2.0 * std::max(n, 1);
+    if ((w / cs + 1) * (h / cs + 1) > maxcells) {
+      cs = std::max(cs, std::sqrt(w * h / maxcells));
+      while ((w / cs + 1) * (h / cs + 1) > maxcells) cs *= 1.5;
+    }
+
+    _cellsize = cs;
+    _x0 = xlo;
+    _y0 = ylo;
+    _ncols = (int)(w / cs) + 1;
+    _nrows = (int)(h / cs) + 1;
+
+    const int ncells = _ncols * _nrows;
+    _start.assign(ncells + 1, 0);
+    _items.resize(n);
+    _cell.resize(n);
+
+    for (int i = 0; i < n; i++) {
+      _cell[i] = cell_index(xs[i], ys[i]);
+      _start[_cell[i] + 1]++ ;
+    }
+
+    for (int c = 0; c < ncells; c++) _start[c + 1] += _start[c];
+
+    std::vector<int> fill(_start.begin(), _start.end() - 1);
+    for (int i = 0; i < n; i++) _items[ fill[_cell[i]]++ ] = i;
+  }
+
+
+  // Calls f(j) for each item in the cell containing (x, y) and the
+  // eight cells around it. Items are visited in cell order and, within
+  // a cell, in ascending index order.
+  //
+  template<class F>
+  void for_each_near(double x, double y, F f) const {
+    for_each_around(clamp_col(x), clamp_row(y), f);
+  }
+
+
+  // As for for_each_near but using the cell that item i was assigned to
+  // when the grid was built, so the result does not depend on whether
+  // the item has moved since.
+  //
+  template<class F>
+  void for_each_near_item(int i, F f) const {
+    for_each_around(_cell[i] % _ncols, _cell[i] / _ncols, f);
+  }
+
+
+  // Calls f(j) for each item in cells overlapping the rectangle
+  // [xlo, xhi] x [ylo, yhi].
+  //
+  template<class F>
+  void for_each_in(double xlo, double ylo, double xhi, double yhi, F f) const {
+    int c0 = clamp_col(xlo), c1 = clamp_col(xhi);
+    int r0 = clamp_row(ylo), r1 = clamp_row(yhi);
+
+    for (int r = r0; r <= r1; r++) {
+      for (int c = c0; c <= c1; c++) {
+        const int cell = r * _ncols + c;
+        for (int k = _start[cell]; k < _start[cell + 1]; k++) f(_items[k]);
+      }
+    }
+  }
+
+
+  int size() const { return _items.size(); }
+
+  int ncells() const { return _ncols * _nrows; }
+
+  double cellsize() const { return _cellsize; }
+
+
+private:
+  template<class F>
+  void for_each_around(int col, int row, F f) const {
+    for (int r = std::max(0, row - 1); r <= std::min(_nrows - 1, row + 1); r++) {
+      for (int c = std::max(0, col - 1); c <= std::min(_ncols - 1, col + 1); c++) {
+        const int cell = r * _ncols + c;
+        for (int k = _start[cell]; k < _start[cell + 1]; k++) f(_items[k]);
+      }
+    }
+  }
+
+  int clamp_col(double x) const {
+    if (!(x > _x0)) return 0;   // also catches NaN
+    double c = (x - _x0) / _cellsize;
+    return c >= _ncols ? _ncols - 1 : (int)c;
+  }
+
+  int clamp_row(double y) const {
+    if (!(y > _y0)) return 0;
+    double r = (y - _y0) / _cellsize;
+    return r >= _nrows ? _nrows - 1 : (int)r;
+  }
+
+  int cell_index(double x, double y) const {
+    return clamp_row(y) * _ncols + clamp_col(x);
+  }
+
+  int _ncols;
+  int _nrows;
+  double _cellsize;
+  double _x0;
+  double _y0;
+
+  std::vector<int> _start;   // offsets into _items, one per cell plus one
+  std::vector<int> _items;   // item indices sorted by cell
+  std::vector<int> _cell;    // cell index for each item
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Functions called from R to create and query a circle index (see
+ * circle_index.h).
+ */
+
+#define STRICT_R_HEADERS
+#include <Rcpp.h>
+#include "circle_index.h"
+
+using namespace Rcpp;
+
+
+CircleIndex* get_circle_index(SEXP index) {
+  XPtr<CircleIndex> p(index);
+  if (!p.get()) Rcpp::stop("Invalid circle index (was it saved and reloaded?)");
+  return p.get();
+}
+
+
+// Creates an index for circles with the given IDs, centres and radii.
+// Returns an external pointer.
+//
+// [[Rcpp::export]]
+SEXP circle_index_new(IntegerVector ids,
+                      NumericVector xs, NumericVector ys, NumericVector rs) {
+
+  const int n = ids.length();
+  if (xs.length() != n || ys.length() != n || rs.length() != n) {
+    Rcpp::stop("ids, xs, ys and rs must be the same length");
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!std::isfinite(xs[i]) || !std::isfinite(ys[i])) Rcpp::stop("centres must be finite");
+    if (!(rs[i] > 0.0)) Rcpp::stop("radii must be positive");
+  }
+
+  XPtr<CircleIndex> p( new CircleIndex(ids.begin(), xs.begin(), ys.begin(), rs.begin(), n), true );
+  return p;
+}
+
+
+// Returns the circles in an index as a data frame with columns id, x, y,
+// radius.
+//
+// [[Rcpp::export]]
+DataFrame circle_index_layout(SEXP index) {
+  const CircleIndex* p = get_circle_index(index);
+
+  return DataFrame::create(
+    Named("id") = IntegerVector(p->ids().begin(), p->ids().end()),
+    Named("x") = NumericVector(p->x().begin(), p->x().end()),
+    Named("y") = NumericVector(p->y().begin(), p->y().end()),
+    Named("radius") = NumericVector(p->r().begin(), p->r().end()) );
+}
+
+
+// For each point (xs[k], ys[k]), finds the ID of the last circle in the
+// index (the one drawn on top) that contains it, or NA if there is none.
+//
+// [[Rcpp::export]]
+IntegerVector circle_index_hit(SEXP index, NumericVector xs, NumericVector ys) {
+  const CircleIndex* p = get_circle_index(index);
+
+  const int n = xs.length();
+  if (ys.length() != n) Rcpp::stop("xs and ys must be the same length");
+
+  IntegerVector hit(n, NA_INTEGER);
+  for (int k = 0; k < n; k++) {
+    p->for_each_containing(xs[k], ys[k], [&](int i) { hit[k] = p->ids()[i]; });
+  }
+
+  return hit;
+}
+
+
+// Returns the IDs of circles in the index that intersect the rectangle
+// [xmin, xmax] x [ymin, ymax], in index order.
+//
+// [[Rcpp::export]]
+IntegerVector circle_index_range(SEXP index,
+                                 double xmin, double xmax,
+                                 double ymin, double ymax) {
+
+  const CircleIndex* p = get_circle_index(index);
+
+  std::vector<int> ids;
+  p->for_each_in_rect(xmin, ymin, xmax, ymax, [&](int i) { ids.push_back(p->ids()[i]); });
+
+  return IntegerVector(ids.begin(), ids.end());
+}
+
+
+// For each point (xs[k], ys[k]), finds the IDs of the k nearest circles,
+// measured from the point to the circle edge. Returns a matrix with one
+// row per point and k columns, nearest first. If there are fewer than k
+// circles, the remaining columns are NA.
+//
+// [[Rcpp::export]]
+IntegerMatrix circle_index_nearest(SEXP index, NumericVector xs, NumericVector ys, int k) {
+  const CircleIndex* p = get_circle_index(index);
+
+  const int n = xs.length();
+  if (ys.length() != n) Rcpp::stop("xs and ys must be the same length");
+  if (k < 1) Rcpp::stop("k must be at least 1");
+
+  for (int j = 0; j < n; j++) {
+    if (!std::isfinite(xs[j]) || !std::isfinite(ys[j])) {
+      Rcpp::stop("query points must be finite");
+    }
+  }
+
+  IntegerMatrix res(n, k);
+  std::fill(res.begin(), res.end(), NA_INTEGER);
+
+  for (int j = 0; j < n; j++) {
+    std::vector<int> nn = p->nearest(xs[j], ys[j], k);
+    for (unsigned int m = 0; m < nn.size(); m++) res(j, m) = p->ids()[ nn[m] ];
+  }
+
+  return res;
+}
+
+
+// Sets new centres for the circles in an index, in index order, and
+// rebuilds the grid.
+//
+// [[Rcpp::export]]
+void circle_index_move(SEXP index, NumericVector xs, NumericVector ys) {
+  CircleIndex* p = get_circle_index(index);
+
+  if (xs.length() != p->size() || ys.length() != p->size()) {
+    Rcpp::stop("xs and ys must have one element per circle in the index");
+  }
+
+  for (int i = 0; i < p->size(); i++) {
+    if (!std::isfinite(xs[i]) || !std::isfinite(ys[i])) Rcpp::stop("centres must be finite");
+  }
+
+  p->move(xs.begin(), ys.begin());
+}
+
+
+// Removes the circles for which keep is false from an index.
+//
+// [[Rcpp::export]]
+void circle_index_subset(SEXP index, LogicalVector keep) {
+  CircleIndex* p = get_circle_index(index);
+
+  if (keep.length() != p->size()) {
+    Rcpp::stop("keep must have one element per circle in the index");
+  }
+
+  std::vector<char> k(p->size());
+  for (int i = 0; i < p->size(); i++) k[i] = keep[i] == TRUE;
+
+  p->subset(k);
+}
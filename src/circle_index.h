@@ -0,0 +1,207 @@
+/*
+ * Persistent spatial index over a set of circles.
+ *
+ * Holds circle centres and radii between calls from R, together with a
+ * uniform grid (see cell_grid.h) over the centres, so that one build can
+ * serve several steps of a pipeline: finding overlaps to remove (see
+ * select_non_overlapping.cpp), taking the circles as input to a repel
+ * layout, and then point and range queries for interactive hit-testing.
+ *
+ * The grid cell size is at least twice the largest radius, so any circle
+ * containing or overlapping a point or another circle is in the same or
+ * an adjacent cell.
+ *
+ * Circles have integer IDs given when the index is created. They are kept
+ * in the order added, which is also the order in which pairs are visited
+ * by the overlap functions.
+ */
+
+#ifndef PACKCIRCLES_CIRCLE_INDEX_H
+#define PACKCIRCLES_CIRCLE_INDEX_H
+
+#include <Rcpp.h>
+#include "cell_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+class CircleIndex {
+public:
+  // Creates an index of n circles with the given IDs, centres and radii.
+  // Radii must be positive and centres finite.
+  CircleIndex(const int* ids, const double* xs, const double* ys,
+              const double* rs, int n) :
+    _ids(ids, ids + n), _x(xs, xs + n), _y(ys, ys + n), _r(rs, rs + n) {
+    rebuild();
+  }
+
+
+  // Rebuilds the grid from the current circles.
+  void rebuild() {
+    const int n = size();
+
+    _rmax = 0.0;
+    for (int i = 0; i < n; i++) _rmax = std::max(_rmax, _r[i]);
+
+    _xlo = _ylo = INFINITY;
+    _xhi = _yhi = -INFINITY;
+    for (int i = 0; i < n; i++) {
+      _xlo = std::min(_xlo, _x[i]);
+      _xhi = std::max(_xhi, _x[i]);
+      _ylo = std::min(_ylo, _y[i]);
+      _yhi = std::max(_yhi, _y[i]);
+    }
+
+    // Cell size is increased slightly to allow for rounding error, as in
+    // select_non_overlapping, so that the grid can be used there
+    const double* px = n > 0 ? &_x[0] : NULL;
+    const double* py = n > 0 ? &_y[0] : NULL;
+    _grid.build(px, py, n, 2.0 * _rmax * (1.0 + 1e-9));
+  }
+
+
+  // Sets new centres for all circles and rebuilds the grid.
+  void move(const double* xs, const double* ys) {
+    std::copy(xs, xs + size(), _x.begin());
+    std::copy(ys, ys + size(), _y.begin());
+    rebuild();
+  }
+
+
+  // Keeps the circles i for which keep[i] is true, in their current order,
+  // and rebuilds the grid.
+  void subset(const std::vector<char>& keep) {
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < _ids.size(); i++) {
+      if (keep[i]) {
+        _ids[k] = _ids[i];
+        _x[k] = _x[i];
+        _y[k] = _y[i];
+        _r[k] = _r[i];
+        k++ ;
+      }
+    }
+
+    _ids.resize(k);
+    _x.resize(k);
+    _y.resize(k);
+    _r.resize(k);
+    rebuild();
+  }
+
+
+  // Calls f(i) for each circle i containing the point (px, py), in
+  // ascending order of i.
+  template<class F>
+  void for_each_containing(double px, double py, F f) const {
+    std::vector<int> hits;
+    _grid.for_each_near(px, py, [&](int i) {
+      const double dx = _x[i] - px;
+      const double dy = _y[i] - py;
+      if (dx*dx + dy*dy <= _r[i] * _r[i]) hits.push_back(i);
+    });
+
+    std::sort(hits.begin(), hits.end());
+    for (unsigned int k = 0; k < hits.size(); k++) f(hits[k]);
+  }
+
+
+  // Calls f(i) for each circle i intersecting the rectangle
+  // [xlo, xhi] x [ylo, yhi], in ascending order of i.
+  template<class F>
+  void for_each_in_rect(double xlo, double ylo, double xhi, double yhi, F f) const {
+    std::vector<int> hits;
+    _grid.for_each_in(xlo - _rmax, ylo - _rmax, xhi + _rmax, yhi + _rmax, [&](int i) {
+      const double dx = _x[i] - std::max(xlo, std::min(xhi, _x[i]));
+      const double dy = _y[i] - std::max(ylo, std::min(yhi, _y[i]));
+      if (dx*dx + dy*dy <= _r[i] * _r[i]) hits.push_back(i);
+    });
+
+    std::sort(hits.begin(), hits.end());
+    for (unsigned int k = 0; k < hits.size(); k++) f(hits[k]);
+  }
+
+
+  // Finds the k circles nearest to the point (px, py), measured from the
+  // point to the edge of each circle (negative if the point is inside).
+  // Returns the circle indices, nearest first, with ties in ascending
+  // order of index, or none if the point is not finite.
+  //
+  // The search looks at circles with centres in a square around the
+  // point, doubling its size until the k nearest have been found: a circle
+  // with its centre outside a square of half-width s is at least
+  // s - rmax from the point.
+  //
+  std::vector<int> nearest(double px, double py, int k) const {
+    const int n = size();
+    k = std::min(k, n);
+    if (!std::isfinite(px) || !std::isfinite(py)) return std::vector<int>();
+
+    std::vector< std::pair<double, int> > cand;
+    double s = _grid.cellsize();
+
+    while (k > 0) {
+      cand.clear();
+      _grid.for_each_in(px - s, py - s, px + s, py + s, [&](int i) {
+        cand.push_back(std::make_pair(edge_distance(i, px, py), i));
+      });
+
+      const bool all = (px - s <= _xlo && px + s >= _xhi &&
+                        py - s <= _ylo && py + s >= _yhi) || !std::isfinite(s);
+
+      if ((int)cand.size() >= k) {
+        std::partial_sort(cand.begin(), cand.begin() + k, cand.end());
+        if (all || cand[k-1].first <= s - _rmax) break;
+      }
+      else if (all) {
+        k = cand.size();
+        std::sort(cand.begin(), cand.end());
+        break;
+      }
+
+      s *= 2.0;
+    }
+
+    std::vector<int> out(k);
+    for (int j = 0; j < k; j++) out[j] = cand[j].second;
+    return out;
+  }
+
+
+  int size() const { return _ids.size(); }
+
+  const std::vector<int>& ids() const { return _ids; }
+  const std::vector<double>& x() const { return _x; }
+  const std::vector<double>& y() const { return _y; }
+  const std::vector<double>& r() const { return _r; }
+
+  double rmax() const { return _rmax; }
+
+  const CellGrid& grid() const { return _grid; }
+
+
+private:
+  double edge_distance(int i, double px, double py) const {
+    const double dx = _x[i] - px;
+    const double dy = _y[i] - py;
+    return std::sqrt(dx*dx + dy*dy) - _r[i];
+  }
+
+  std::vector<int> _ids;
+  std::vector<double> _x;
+  std::vector<double> _y;
+  std::vector<double> _r;
+
+  double _rmax;
+  double _xlo, _xhi, _ylo, _yhi;   // range of centres
+  CellGrid _grid;
+};
+
+
+// Gets the index from an external pointer, checking that it is still
+// valid (e.g. it has not been restored from a saved workspace).
+CircleIndex* get_circle_index(SEXP index);
+
+#endif
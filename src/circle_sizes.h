@@ -0,0 +1,27 @@
+/*
+ * Handling of circle sizes passed from R, shared by the layout functions
+ * that take a vector of sizes as either areas or radii.
+ *
+ * As in the R code, circles with missing (NA or NaN) or non-positive sizes
+ * are ignored by the layouts, and have missing values in the output.
+ */
+
+#ifndef PACKCIRCLES_CIRCLE_SIZES_H
+#define PACKCIRCLES_CIRCLE_SIZES_H
+
+#include <cmath>
+
+// Whether a circle size is usable. Comparisons with NA and NaN are false,
+// so missing sizes are not valid.
+inline bool valid_size(double size) {
+  return size > 0.0;
+}
+
+
+// Converts a valid size to a radius. If area is true, the size is the
+// circle area, otherwise it is the radius.
+inline double size_to_radius(double size, bool area) {
+  return area ? sqrt(size / M_PI) : size;
+}
+
+#endif
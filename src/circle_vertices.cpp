@@ -0,0 +1,132 @@
+/*
+ * Vertex coordinates for drawing circles as polygons.
+ *
+ * Used by circleLayoutVertices to generate the vertices for all circles in
+ * a layout in a single pass, rather than one circle at a time in R.
+ */
+
+#define STRICT_R_HEADERS
+#include <Rcpp.h>
+#include "layout_file.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+
+
+// Writes npoints + 1 vertices for each of N circles to outx and outy, the
+// last being a copy of the first to close the polygon. Angles run from 0 to
+// 2 pi in equal steps, computed as by seq(0, 2*pi, length.out = npoints + 1)
+// in R, and the sine and cosine of each angle are calculated once for all
+// circles. Circles are divided between threads.
+//
+static void fill_vertices(const double* px, const double* py, const double* pr, int N,
+                          int npoints, int nthreads, double* outx, double* outy) {
+  const int nv = npoints + 1;
+
+  std::vector<double> cosa(nv);
+  std::vector<double> sina(nv);
+
+  const double by = 2 * M_PI / npoints;
+  for (int i = 0; i < nv; i++) {
+    double a = i == 0 ? 0.0 : (i == npoints ? 2 * M_PI : i * by);
+    cosa[i] = cos(a);
+    sina[i] = sin(a);
+  }
+
+  const double* pcos = &cosa[0];
+  const double* psin = &sina[0];
+
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (int k = 0; k < N; k++) {
+    double* vx = outx + (R_xlen_t)k * nv;
+    double* vy = outy + (R_xlen_t)k * nv;
+
+    for (int i = 0; i < nv; i++) {
+      vx[i] = px[k] + pr[k] * pcos[i];
+      vy[i] = py[k] + pr[k] * psin[i];
+    }
+  }
+}
+
+
+// Generates npoints + 1 vertices for each circle (see fill_vertices).
+//
+// @param xc circle centre X ordinates.
+// @param yc circle centre Y ordinates.
+// @param radius circle radii.
+// @param npoints number of distinct vertices per circle.
+// @param nthreads number of threads to use; circles are divided between
+//   threads.
+//
+// @return a list with vectors x and y of vertex coordinates, with the
+//   vertices for each circle in turn.
+//
+// [[Rcpp::export]]
+List circle_vertices(NumericVector xc, NumericVector yc, NumericVector radius,
+                     int npoints, int nthreads) {
+
+  const int N = radius.length();
+  if (xc.length() != N || yc.length() != N) {
+    Rcpp::stop("xc, yc and radius must be the same length");
+  }
+  if (npoints < 1) Rcpp::stop("npoints must be at least 1");
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+
+  const int nv = npoints + 1;
+
+  NumericVector xs((R_xlen_t)N * nv);
+  NumericVector ys((R_xlen_t)N * nv);
+
+  fill_vertices(xc.begin(), yc.begin(), radius.begin(), N, npoints, nthreads,
+                xs.begin(), ys.begin());
+
+  return List::create(
+    Named("x") = xs,
+    Named("y") = ys);
+}
+
+
+// Generates vertices for the circles in a layout file (see layout_file.h)
+// and writes them to a new layout file, replacing any existing file. The
+// output has npoints + 1 rows for each circle, in the same order, with
+// the vertex coordinates in the x and y columns and the circle radius and
+// ID repeated in the radius and id columns.
+//
+// @return the number of rows written.
+//
+// [[Rcpp::export]]
+double layout_file_vertices(std::string inpath, std::string outpath,
+                            int npoints, int nthreads) {
+
+  if (npoints < 1) Rcpp::stop("npoints must be at least 1");
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+  if (inpath == outpath) Rcpp::stop("input and output files must be different");
+
+  LayoutFile in(inpath, false);
+  if (in.size() > INT_MAX) Rcpp::stop("too many circles in layout file");
+
+  const int N = in.size();
+  const int nv = npoints + 1;
+  LayoutFile out(outpath, (int64_t)N * nv);
+
+  fill_vertices(in.x(), in.y(), in.radius(), N, npoints, nthreads, out.x(), out.y());
+
+  double* outr = out.radius();
+  double* outid = out.id();
+  for (int k = 0; k < N; k++) {
+    std::fill(outr + (R_xlen_t)k * nv, outr + (R_xlen_t)(k + 1) * nv, in.radius()[k]);
+    std::fill(outid + (R_xlen_t)k * nv, outid + (R_xlen_t)(k + 1) * nv, in.id()[k]);
+  }
+
+  return (double) out.size();
+}
@@ -8,16 +8,68 @@
 */
 
 /* .Call calls */
+extern SEXP _packcircles_circle_index_hit(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_circle_index_layout(SEXP);
+extern SEXP _packcircles_circle_index_move(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_circle_index_nearest(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_circle_index_new(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_circle_index_range(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_circle_index_subset(SEXP, SEXP);
+extern SEXP _packcircles_circle_vertices(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_do_nested_layout(SEXP, SEXP, SEXP, SEXP);
 extern SEXP _packcircles_do_progressive_layout(SEXP);
-extern SEXP _packcircles_doCirclePack(SEXP, SEXP);
-extern SEXP _packcircles_iterate_layout(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
-extern SEXP _packcircles_select_non_overlapping(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_do_progressive_layout_into(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_do_progressive_layout_sizes(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_doCirclePack(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_exact_non_overlapping(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_iterate_layout(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_layout_file_progressive(SEXP);
+extern SEXP _packcircles_layout_file_read(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_layout_file_repel(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_layout_file_rows(SEXP);
+extern SEXP _packcircles_layout_file_vertices(SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_layout_file_write(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_progressive_stream_add(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_progressive_stream_new(void);
+extern SEXP _packcircles_repel_state_add(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_repel_state_layout(SEXP);
+extern SEXP _packcircles_repel_state_new(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP _packcircles_repel_state_remove(SEXP, SEXP);
+extern SEXP _packcircles_repel_state_resize(SEXP, SEXP, SEXP);
+extern SEXP _packcircles_repel_state_step(SEXP, SEXP);
+extern SEXP _packcircles_select_non_overlapping(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_packcircles_do_progressive_layout",  (DL_FUNC) &_packcircles_do_progressive_layout,  1},
-    {"_packcircles_doCirclePack",           (DL_FUNC) &_packcircles_doCirclePack,           2},
-    {"_packcircles_iterate_layout",         (DL_FUNC) &_packcircles_iterate_layout,         8},
-    {"_packcircles_select_non_overlapping", (DL_FUNC) &_packcircles_select_non_overlapping, 3},
+    {"_packcircles_circle_index_hit",            (DL_FUNC) &_packcircles_circle_index_hit,             3},
+    {"_packcircles_circle_index_layout",         (DL_FUNC) &_packcircles_circle_index_layout,          1},
+    {"_packcircles_circle_index_move",           (DL_FUNC) &_packcircles_circle_index_move,            3},
+    {"_packcircles_circle_index_nearest",        (DL_FUNC) &_packcircles_circle_index_nearest,         4},
+    {"_packcircles_circle_index_new",            (DL_FUNC) &_packcircles_circle_index_new,             4},
+    {"_packcircles_circle_index_range",          (DL_FUNC) &_packcircles_circle_index_range,           5},
+    {"_packcircles_circle_index_subset",         (DL_FUNC) &_packcircles_circle_index_subset,          2},
+    {"_packcircles_circle_vertices",             (DL_FUNC) &_packcircles_circle_vertices,              5},
+    {"_packcircles_do_nested_layout",            (DL_FUNC) &_packcircles_do_nested_layout,             4},
+    {"_packcircles_do_progressive_layout",       (DL_FUNC) &_packcircles_do_progressive_layout,        1},
+    {"_packcircles_do_progressive_layout_into",  (DL_FUNC) &_packcircles_do_progressive_layout_into,   3},
+    {"_packcircles_do_progressive_layout_sizes", (DL_FUNC) &_packcircles_do_progressive_layout_sizes,  6},
+    {"_packcircles_doCirclePack",                (DL_FUNC) &_packcircles_doCirclePack,                 7},
+    {"_packcircles_exact_non_overlapping",       (DL_FUNC) &_packcircles_exact_non_overlapping,        5},
+    {"_packcircles_iterate_layout",              (DL_FUNC) &_packcircles_iterate_layout,              21},
+    {"_packcircles_layout_file_progressive",     (DL_FUNC) &_packcircles_layout_file_progressive,      1},
+    {"_packcircles_layout_file_read",            (DL_FUNC) &_packcircles_layout_file_read,             3},
+    {"_packcircles_layout_file_repel",           (DL_FUNC) &_packcircles_layout_file_repel,           16},
+    {"_packcircles_layout_file_rows",            (DL_FUNC) &_packcircles_layout_file_rows,             1},
+    {"_packcircles_layout_file_vertices",        (DL_FUNC) &_packcircles_layout_file_vertices,         4},
+    {"_packcircles_layout_file_write",           (DL_FUNC) &_packcircles_layout_file_write,            5},
+    {"_packcircles_progressive_stream_add",      (DL_FUNC) &_packcircles_progressive_stream_add,       3},
+    {"_packcircles_progressive_stream_new",      (DL_FUNC) &_packcircles_progressive_stream_new,       0},
+    {"_packcircles_repel_state_add",             (DL_FUNC) &_packcircles_repel_state_add,              6},
+    {"_packcircles_repel_state_layout",          (DL_FUNC) &_packcircles_repel_state_layout,           1},
+    {"_packcircles_repel_state_new",             (DL_FUNC) &_packcircles_repel_state_new,              7},
+    {"_packcircles_repel_state_remove",          (DL_FUNC) &_packcircles_repel_state_remove,           2},
+    {"_packcircles_repel_state_resize",          (DL_FUNC) &_packcircles_repel_state_resize,           3},
+    {"_packcircles_repel_state_step",            (DL_FUNC) &_packcircles_repel_state_step,             2},
+    {"_packcircles_select_non_overlapping",      (DL_FUNC) &_packcircles_select_non_overlapping,       6},
     {NULL, NULL, 0}
 };
 
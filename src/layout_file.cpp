@@ -0,0 +1,152 @@
+/*
+ * Memory mapping for layout files (see layout_file.h), and functions
+ * called from R to write and read them. The functions that run layouts on
+ * files are with the layout code: layout_file_progressive
+ * (pmenzel_circle_pack.cpp), layout_file_repel (packcircles.cpp) and
+ * layout_file_vertices (circle_vertices.cpp).
+ */
+
+#define STRICT_R_HEADERS
+#include <Rcpp.h>
+#include "layout_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+using namespace Rcpp;
+
+
+#ifdef _WIN32
+
+void LayoutFile::map_file(const std::string& path, bool writable, bool create, size_t newsize) {
+  HANDLE file = CreateFileA(path.c_str(),
+                            writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            create ? CREATE_ALWAYS : OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) fail("cannot open layout file", path);
+  _file = (intptr_t) file;
+
+  if (create) {
+    _size = newsize;
+  } else {
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file, &sz)) fail("cannot get size of layout file", path);
+    _size = (size_t)sz.QuadPart;
+    if (_size == 0) fail("not a layout file", path);
+  }
+
+  const uint64_t sz64 = _size;
+  HANDLE mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                      (DWORD)(sz64 >> 32), (DWORD)(sz64 & 0xFFFFFFFF), NULL);
+  if (mapping == NULL) fail("cannot map layout file", path);
+  _mapping = (intptr_t) mapping;
+
+  _data = (char*) MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+  if (_data == NULL) fail("cannot map layout file", path);
+}
+
+
+void LayoutFile::close() {
+  if (_data) UnmapViewOfFile(_data);
+  if (_mapping != -1) CloseHandle((HANDLE) _mapping);
+  if (_file != -1) CloseHandle((HANDLE) _file);
+  init();
+}
+
+#else
+
+void LayoutFile::map_file(const std::string& path, bool writable, bool create, size_t newsize) {
+  int flags = writable ? O_RDWR : O_RDONLY;
+  if (create) flags |= O_CREAT | O_TRUNC;
+
+  const int fd = ::open(path.c_str(), flags, 0644);
+  if (fd < 0) fail("cannot open layout file", path);
+  _file = fd;
+
+  if (create) {
+    if (ftruncate(fd, newsize) != 0) fail("cannot set size of layout file", path);
+    _size = newsize;
+  } else {
+    struct stat st;
+    if (fstat(fd, &st) != 0) fail("cannot get size of layout file", path);
+    _size = st.st_size;
+    if (_size == 0) fail("not a layout file", path);
+  }
+
+  void* p = mmap(NULL, _size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                 MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) fail("cannot map layout file", path);
+  _data = (char*) p;
+}
+
+
+void LayoutFile::close() {
+  if (_data) munmap(_data, _size);
+  if (_file >= 0) ::close((int) _file);
+  init();
+}
+
+#endif
+
+
+// Writes circles to a new layout file, replacing any existing file.
+// Missing values are written as NaN.
+//
+// [[Rcpp::export]]
+void layout_file_write(std::string path,
+                       NumericVector ids, NumericVector xs,
+                       NumericVector ys, NumericVector rs) {
+
+  const R_xlen_t n = ids.length();
+  if (xs.length() != n || ys.length() != n || rs.length() != n) {
+    Rcpp::stop("ids, xs, ys and rs must be the same length");
+  }
+
+  LayoutFile f(path, (int64_t) n);
+  std::copy(xs.begin(), xs.end(), f.x());
+  std::copy(ys.begin(), ys.end(), f.y());
+  std::copy(rs.begin(), rs.end(), f.radius());
+  std::copy(ids.begin(), ids.end(), f.id());
+}
+
+
+// Returns the number of rows in a layout file.
+//
+// [[Rcpp::export]]
+double layout_file_rows(std::string path) {
+  LayoutFile f(path, false);
+  return (double) f.size();
+}
+
+
+// Reads count rows from a layout file, starting at row `from` (counting
+// from 0). Returns a data frame with columns id, x, y and radius.
+//
+// [[Rcpp::export]]
+DataFrame layout_file_read(std::string path, double from, double count) {
+  LayoutFile f(path, false);
+
+  if (from < 0 || count < 0 || from + count > (double) f.size()) {
+    Rcpp::stop("rows are outside the layout file");
+  }
+
+  const R_xlen_t i0 = (R_xlen_t) from;
+  const R_xlen_t n = (R_xlen_t) count;
+
+  return DataFrame::create(
+    Named("id") = NumericVector(f.id() + i0, f.id() + i0 + n),
+    Named("x") = NumericVector(f.x() + i0, f.x() + i0 + n),
+    Named("y") = NumericVector(f.y() + i0, f.y() + i0 + n),
+    Named("radius") = NumericVector(f.radius() + i0, f.radius() + i0 + n) );
+}
@@ -0,0 +1,166 @@
+/*
+ * Memory-mapped binary layout files.
+ *
+ * A layout file holds a set of circles in a simple columnar format, so that
+ * very large layouts can be passed between the layout functions and other
+ * processes without going through R data frames or text files:
+ *
+ *   header    64 bytes (LayoutFileHeader below)
+ *   x         n float64 values, circle centre X ordinates
+ *   y         n float64 values, circle centre Y ordinates
+ *   radius    n float64 values
+ *   id        n float64 values, circle IDs
+ *
+ * Values are in the byte order of the machine that wrote the file, which
+ * is recorded in the header. Missing values are stored as NaN.
+ *
+ * The file is mapped into memory rather than read, so the layout functions
+ * work directly on the columns and only the pages they touch are loaded.
+ * Only uses standard library and operating system code, so it is safe to
+ * use from worker threads, but a LayoutFile object should not be shared
+ * between threads while it is being opened or closed.
+ *
+ * The mapping code, and the operating system headers it needs, are in
+ * layout_file.cpp, so that windows.h (which defines macros such as near,
+ * far, TRUE and FALSE) is not included by the layout code.
+ */
+
+#ifndef PACKCIRCLES_LAYOUT_FILE_H
+#define PACKCIRCLES_LAYOUT_FILE_H
+
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+const char LAYOUT_FILE_MAGIC[9] = "PCLAYOUT";
+
+struct LayoutFileHeader {
+  char magic[8];        // "PCLAYOUT"
+  uint32_t version;     // format version, currently 1
+  uint32_t byteorder;   // 0x01020304 written in the byte order of the file
+  int64_t n;            // number of rows (circles)
+  char reserved[40];    // zero; pads the header to 64 bytes
+};
+
+
+class LayoutFile {
+public:
+  static const int NCOLUMNS = 4;
+  enum Column { X = 0, Y = 1, RADIUS = 2, ID = 3 };
+
+  // Opens an existing layout file, for reading and writing if writable is
+  // true, otherwise read only. Throws std::runtime_error if the file
+  // cannot be opened or is not a valid layout file.
+  LayoutFile(const std::string& path, bool writable) {
+    init();
+    map_file(path, writable, false, 0);
+
+    std::string err = check_header();
+    if (!err.empty()) {
+      close();
+      throw std::runtime_error(err + ": " + path);
+    }
+  }
+
+  // Creates a layout file with n rows, replacing any existing file. All
+  // values are initially zero.
+  LayoutFile(const std::string& path, int64_t n) {
+    init();
+    if (n < 0) throw std::runtime_error("number of rows must not be negative");
+    map_file(path, true, true, file_size(n));
+
+    LayoutFileHeader* h = header();
+    std::memcpy(h->magic, LAYOUT_FILE_MAGIC, 8);
+    h->version = VERSION;
+    h->byteorder = BYTEORDER;
+    h->n = n;
+  }
+
+  ~LayoutFile() { close(); }
+
+  // Number of rows
+  int64_t size() const { return header()->n; }
+
+  double* column(Column k) {
+    return reinterpret_cast<double*>(_data + sizeof(LayoutFileHeader)) + k * size();
+  }
+
+  const double* column(Column k) const {
+    return reinterpret_cast<const double*>(_data + sizeof(LayoutFileHeader)) + k * size();
+  }
+
+  double* x() { return column(X); }
+  double* y() { return column(Y); }
+  double* radius() { return column(RADIUS); }
+  double* id() { return column(ID); }
+
+  const double* x() const { return column(X); }
+  const double* y() const { return column(Y); }
+  const double* radius() const { return column(RADIUS); }
+  const double* id() const { return column(ID); }
+
+
+private:
+  static const uint32_t VERSION = 1;
+  static const uint32_t BYTEORDER = 0x01020304;
+
+  // Copying would unmap the file twice
+  LayoutFile(const LayoutFile&);
+  LayoutFile& operator=(const LayoutFile&);
+
+  static size_t file_size(int64_t n) {
+    return sizeof(LayoutFileHeader) + (size_t)n * NCOLUMNS * sizeof(double);
+  }
+
+  LayoutFileHeader* header() { return reinterpret_cast<LayoutFileHeader*>(_data); }
+
+  const LayoutFileHeader* header() const {
+    return reinterpret_cast<const LayoutFileHeader*>(_data);
+  }
+
+  // Returns an error message if the mapped file is not a valid layout
+  // file, otherwise an empty string
+  std::string check_header() const {
+    if (_size < sizeof(LayoutFileHeader)) return "not a layout file";
+
+    const LayoutFileHeader* h = header();
+    if (std::memcmp(h->magic, LAYOUT_FILE_MAGIC, 8) != 0) return "not a layout file";
+    if (h->byteorder != BYTEORDER) return "layout file has a different byte order";
+    if (h->version != VERSION) return "unsupported layout file version";
+    if (h->n < 0 || _size != file_size(h->n)) return "layout file is truncated or corrupt";
+
+    return "";
+  }
+
+  void init() {
+    _data = NULL;
+    _size = 0;
+    _file = -1;
+    _mapping = -1;
+  }
+
+  // Opens or creates the file and maps it into memory. When creating, the
+  // file is extended to newsize bytes. Defined in layout_file.cpp.
+  void map_file(const std::string& path, bool writable, bool create, size_t newsize);
+
+  // Unmaps and closes the file. Defined in layout_file.cpp.
+  void close();
+
+  // Releases anything opened so far and throws an error
+  void fail(const std::string& msg, const std::string& path) {
+    close();
+    throw std::runtime_error(msg + ": " + path);
+  }
+
+  char* _data;
+  size_t _size;
+
+  // Operating system handles for the open file and its mapping: a file
+  // descriptor (with no separate mapping handle) on POSIX systems, or
+  // HANDLE values on Windows. -1 if not open.
+  intptr_t _file;
+  intptr_t _mapping;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Monitoring of long-running layout loops: the iterations of the repel
+ * layout (packcircles.cpp) and the radius relaxation of the graph layout
+ * (pads_circle_pack.cpp).
+ *
+ * The loop calls LayoutMonitor::done once per iteration. This checks for
+ * a user interrupt (so that the loop can be stopped with Ctrl-C or by a
+ * time limit set with setTimeLimit in R), calls an optional R progress
+ * function, and checks an optional limit on the elapsed time. Interrupt
+ * checks and progress calls are made at most every INTERRUPT_INTERVAL and
+ * PROGRESS_INTERVAL seconds respectively, so cost little however short
+ * the iterations are.
+ *
+ * Since the monitor calls back into R, it must only be used from the main
+ * thread, outside of parallel regions.
+ */
+
+#ifndef PACKCIRCLES_LAYOUT_MONITOR_H
+#define PACKCIRCLES_LAYOUT_MONITOR_H
+
+#include <Rcpp.h>
+#include <chrono>
+
+class LayoutMonitor {
+public:
+  // timelimit - seconds allowed for the loop, from when the monitor is
+  //             created (Inf for no limit)
+  // progress  - an R function to be called with the number of iterations
+  //             done and a value describing the state of the layout, or
+  //             NULL
+  LayoutMonitor(double timelimit, SEXP progress) :
+    _timelimit(timelimit),
+    _progress(progress),
+    _start(std::chrono::steady_clock::now()),
+    _last_check(0.0),
+    _last_progress(0.0),
+    _timedout(false) {}
+
+  // Called after each iteration with the number of iterations done so
+  // far and the value to pass to the progress function. Returns true if
+  // the loop should stop because the time limit has been reached.
+  // Throws an exception if the user has interrupted.
+  bool done(int niter, double value) {
+    const double t = elapsed();
+
+    if (t - _last_check >= INTERRUPT_INTERVAL) {
+      Rcpp::checkUserInterrupt();
+      _last_check = t;
+    }
+
+    if (!_progress.isNULL() && t - _last_progress >= PROGRESS_INTERVAL) {
+      Rcpp::Function f(_progress);
+      f(niter, value);
+      _last_progress = t;
+    }
+
+    if (t >= _timelimit) _timedout = true;
+    return _timedout;
+  }
+
+  // Whether the loop was stopped by the time limit
+  bool timedout() const { return _timedout; }
+
+private:
+  static constexpr double INTERRUPT_INTERVAL = 0.1;
+  static constexpr double PROGRESS_INTERVAL = 1.0;
+
+  double elapsed() const {
+    return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - _start).count();
+  }
+
+  double _timelimit;
+  Rcpp::RObject _progress;
+  std::chrono::steady_clock::time_point _start;
+  double _last_check;
+  double _last_progress;
+  bool _timedout;
+};
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * Nested (hierarchical) circle packing.
+ *
+ * Leaf circles are packed within their parent using the progressive layout
+ * algorithm; each parent is then sized to a circle enclosing its children,
+ * and packed in turn with its siblings one level up. Positions
+ * are calculated relative to each parent and converted to absolute
+ * coordinates in a final pass from the root(s) down.
+ *
+ * The enclosing circle of a set of circles is found with the method used
+ * by d3-hierarchy (packEnclose): after a fixed shuffle, circles are added
+ * one at a time, and whenever one is not enclosed by the current circle
+ * the basis (the one to three circles that the enclosing circle touches)
+ * is extended to include it and the scan restarts. This is a heuristic
+ * in the style of Welzl's algorithm rather than an exact implementation
+ * of it. The functions encloses_not to enclose_simple below are ported
+ * from d3-hierarchy's enclose.js, which is distributed under the
+ * following licence:
+ *
+ *   Copyright 2010-2021 Mike Bostock
+ *
+ *   Permission to use, copy, modify, and/or distribute this software for
+ *   any purpose with or without fee is hereby granted, provided that the
+ *   above copyright notice and this permission notice appear in all
+ *   copies.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *   PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define STRICT_R_HEADERS
+#include <Rcpp.h>
+#include "progressive_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+
+
+struct Disc {
+  Disc() : x(0.0), y(0.0), r(0.0) {}
+  Disc(double x_, double y_, double r_) : x(x_), y(y_), r(r_) {}
+
+  double x;
+  double y;
+  double r;
+};
+
+
+// Whether disc a fails to enclose disc b.
+static bool encloses_not(const Disc& a, const Disc& b) {
+  double dr = a.r - b.r;
+  double dx = b.x - a.x;
+  double dy = b.y - a.y;
+  return dr < 0 || dr * dr < dx * dx + dy * dy;
+}
+
+
+// Whether disc a encloses disc b, allowing for rounding error.
+static bool encloses_weak(const Disc& a, const Disc& b) {
+  double dr = a.r - b.r + std::max(std::max(a.r, b.r), 1.0) * 1e-9;
+  double dx = b.x - a.x;
+  double dy = b.y - a.y;
+  return dr > 0 && dr * dr > dx * dx + dy * dy;
+}
+
+
+static bool encloses_weak_all(const Disc& a, const std::vector<Disc>& B) {
+  for (unsigned int i = 0; i < B.size(); i++) {
+    if (!encloses_weak(a, B[i])) return false;
+  }
+  return true;
+}
+
+
+// Smallest disc enclosing discs a and b.
+static Disc enclose2(const Disc& a, const Disc& b) {
+  double x21 = b.x - a.x;
+  double y21 = b.y - a.y;
+  double r21 = b.r - a.r;
+  double len = sqrt(x21 * x21 + y21 * y21);
+
+  if (len == 0.0) return a.r >= b.r ? a : b;
+
+  return Disc( (a.x + b.x + x21 / len * r21) / 2,
+               (a.y + b.y + y21 / len * r21) / 2,
+               (len + a.r + b.r) / 2 );
+}
+
+
+// Smallest disc enclosing and internally tangent to discs a, b and c
+// (the Apollonius problem).
+static Disc enclose3(const Disc& a, const Disc& b, const Disc& c) {
+  double a2 = a.x - b.x, a3 = a.x - c.x;
+  double b2 = a.y - b.y, b3 = a.y - c.y;
+  double c2 = b.r - a.r, c3 = c.r - a.r;
+
+  double d1 = a.x * a.x + a.y * a.y - a.r * a.r;
+  double d2 = d1 - b.x * b.x - b.y * b.y + b.r * b.r;
+  double d3 = d1 - c.x * c.x - c.y * c.y + c.r * c.r;
+
+  double ab = a3 * b2 - a2 * b3;
+  double xa = (b2 * d3 - b3 * d2) / (ab * 2) - a.x;
+  double xb = (b3 * c2 - b2 * c3) / ab;
+  double ya = (a3 * d2 - a2 * d3) / (ab * 2) - a.y;
+  double yb = (a2 * c3 - a3 * c2) / ab;
+
+  double A = xb * xb + yb * yb - 1;
+  double B = 2 * (a.r + xa * xb + ya * yb);
+  double C = xa * xa + ya * ya - a.r * a.r;
+  double r = -(std::fabs(A) > 1e-6 ? (B + sqrt(B * B - 4 * A * C)) / (2 * A) : C / B);
+
+  return Disc(a.x + xa + xb * r, a.y + ya + yb * r, r);
+}
+
+
+static Disc enclose_basis(const std::vector<Disc>& B) {
+  if (B.size() == 1) return B[0];
+  if (B.size() == 2) return enclose2(B[0], B[1]);
+  return enclose3(B[0], B[1], B[2]);
+}
+
+
+// Finds the smallest basis (one to three discs from B plus p) whose
+// enclosing disc encloses p and all of B. Returns false if none is found,
+// which can only happen through rounding error.
+static bool extend_basis(std::vector<Disc>& B, const Disc& p) {
+  if (encloses_weak_all(p, B)) {
+    B.assign(1, p);
+    return true;
+  }
+
+  for (unsigned int i = 0; i < B.size(); i++) {
+    if (encloses_not(p, B[i]) && encloses_weak_all(enclose2(B[i], p), B)) {
+      Disc bi = B[i];
+      B.clear();
+      B.push_back(bi);
+      B.push_back(p);
+      return true;
+    }
+  }
+
+  for (unsigned int i = 0; i + 1 < B.size(); i++) {
+    for (unsigned int j = i + 1; j < B.size(); j++) {
+      if (encloses_not(enclose2(B[i], B[j]), p) &&
+          encloses_not(enclose2(B[i], p), B[j]) &&
+          encloses_not(enclose2(B[j], p), B[i]) &&
+          encloses_weak_all(enclose3(B[i], B[j], p), B)) {
+        Disc bi = B[i], bj = B[j];
+        B.clear();
+        B.push_back(bi);
+        B.push_back(bj);
+        B.push_back(p);
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+// Simple (not minimal) enclosing disc centred on the centroid, used if
+// the exact algorithm fails.
+static Disc enclose_simple(const std::vector<Disc>& discs) {
+  double cx = 0.0, cy = 0.0;
+  for (unsigned int i = 0; i < discs.size(); i++) {
+    cx += discs[i].x;
+    cy += discs[i].y;
+  }
+  cx /= discs.size();
+  cy /= discs.size();
+
+  double r = 0.0;
+  for (unsigned int i = 0; i < discs.size(); i++) {
+    double dx = discs[i].x - cx;
+    double dy = discs[i].y - cy;
+    r = std::max(r, sqrt(dx * dx + dy * dy) + discs[i].r);
+  }
+
+  return Disc(cx, cy, r);
+}
+
+
+// Disc enclosing a non-empty set of discs, as found by d3-hierarchy (see
+// above); usually the smallest, but this is not guaranteed. The discs are
+// shuffled with a fixed seed so that the result is reproducible (and does
+// not depend on R's random number generator, which cannot be used from
+// worker threads).
+static Disc enclose(std::vector<Disc> discs) {
+  const int n = discs.size();
+
+  unsigned int seed = 2463534242u;
+  for (int i = n - 1; i > 0; i--) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    std::swap(discs[i], discs[seed % (i + 1)]);
+  }
+
+  std::vector<Disc> B;
+  Disc e;
+  bool have = false;
+
+  int i = 0;
+  while (i < n) {
+    if (have && encloses_weak(e, discs[i])) {
+      i++ ;
+    }
+    else {
+      if (!extend_basis(B, discs[i])) return enclose_simple(discs);
+      e = enclose_basis(B);
+      have = true;
+      i = 0;
+    }
+  }
+
+  return e;
+}
+
+
+// Packs circles and returns their positions relative to the centre of
+// their smallest enclosing circle, together with that circle.
+static Disc pack_and_enclose(const std::vector<double>& radii,
+                             std::vector<double>& xs,
+                             std::vector<double>& ys) {
+  const int n = radii.size();
+
+  NodePool nodes(&radii[0], n);
+  place_circles(nodes);
+
+  std::vector<Disc> discs(n);
+  for (int k = 0; k < n; k++) discs[k] = Disc(nodes[k].x, nodes[k].y, nodes[k].radius);
+
+  Disc e = enclose(discs);
+
+  xs.resize(n);
+  ys.resize(n);
+  for (int k = 0; k < n; k++) {
+    xs[k] = nodes[k].x - e.x;
+    ys[k] = nodes[k].y - e.y;
+  }
+
+  return e;
+}
+
+
+// Nested circle packing.
+//
+// @param parent for each node, the 1-based index of its parent node, or 0
+//   for a root node.
+// @param radii radius of each node. Values for nodes with children are
+//   ignored.
+// @param padding space to add between the children of a node and the
+//   enclosing circle.
+// @param nthreads number of threads to use. Nodes at the same depth in the
+//   tree are packed in parallel.
+//
+// @return a data frame with the absolute position and radius of each node,
+//   and its depth in the tree (0 for root nodes).
+//
+// [[Rcpp::export]]
+DataFrame do_nested_layout(IntegerVector parent,
+                           NumericVector radii,
+                           double padding,
+                           int nthreads) {
+
+  const int N = parent.length();
+  if (radii.length() != N) Rcpp::stop("parent and radii must be the same length");
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+
+  // Children of each node in compressed form, keeping input order
+  std::vector<int> start(N + 2, 0);
+  for (int i = 0; i < N; i++) {
+    int p = parent[i];
+    if (p == NA_INTEGER || p < 0 || p > N) Rcpp::stop("invalid parent index");
+    if (p == i + 1) Rcpp::stop("a node cannot be its own parent");
+    start[p + 1]++ ;
+  }
+  for (int p = 0; p <= N; p++) start[p + 1] += start[p];
+
+  // children[start[p] ... start[p+1]-1] are the children of node p (1-based;
+  // p = 0 for roots)
+  std::vector<int> children(N);
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  for (int i = 0; i < N; i++) children[ fill[parent[i]]++ ] = i;
+
+  // Breadth-first order from the roots, which also gives depths
+  std::vector<int> order;
+  order.reserve(N);
+  std::vector<int> depth(N, 0);
+
+  for (int k = start[0]; k < start[1]; k++) order.push_back(children[k]);
+  for (unsigned int q = 0; q < order.size(); q++) {
+    const int v = order[q];
+    for (int k = start[v + 1]; k < start[v + 2]; k++) {
+      int c = children[k];
+      depth[c] = depth[v] + 1;
+      order.push_back(c);
+    }
+  }
+
+  if ((int)order.size() != N) Rcpp::stop("parent indices contain a cycle");
+
+  for (int i = 0; i < N; i++) {
+    bool leaf = start[i + 1] == start[i + 2];
+    if (leaf && !(radii[i] > 0)) Rcpp::stop("leaf radii must be positive");
+  }
+
+  std::vector<double> rad(radii.begin(), radii.end());
+  std::vector<double> relx(N, 0.0);
+  std::vector<double> rely(N, 0.0);
+
+  // Bottom-up pass. The breadth-first order lists nodes by increasing depth,
+  // so each level is a contiguous block of it.
+  const int maxdepth = N > 0 ? depth[ order[N - 1] ] : 0;
+  std::vector<int> level_start(maxdepth + 2, 0);
+  for (int q = 0; q < N; q++) level_start[ depth[order[q]] + 1 ]++ ;
+  for (int d = 0; d <= maxdepth; d++) level_start[d + 1] += level_start[d];
+
+  double* prad = N > 0 ? &rad[0] : NULL;
+  double* prelx = N > 0 ? &relx[0] : NULL;
+  double* prely = N > 0 ? &rely[0] : NULL;
+  const int* porder = N > 0 ? &order[0] : NULL;
+  const int* pstart = &start[0];
+  const int* pchildren = N > 0 ? &children[0] : NULL;
+
+  for (int d = maxdepth - 1; d >= 0; d--) {
+    const int from = level_start[d];
+    const int to = level_start[d + 1];
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int q = from; q < to; q++) {
+      const int v = porder[q];
+      const int c0 = pstart[v + 1];
+      const int nc = pstart[v + 2] - c0;
+      if (nc == 0) continue;
+
+      std::vector<double> cr(nc), cx, cy;
+      for (int k = 0; k < nc; k++) cr[k] = prad[ pchildren[c0 + k] ];
+
+      Disc e = pack_and_enclose(cr, cx, cy);
+
+      prad[v] = e.r + padding;
+      for (int k = 0; k < nc; k++) {
+        prelx[ pchildren[c0 + k] ] = cx[k];
+        prely[ pchildren[c0 + k] ] = cy[k];
+      }
+    }
+  }
+
+  // Root nodes are packed together if there is more than one
+  const int nroots = start[1] - start[0];
+  if (nroots > 1) {
+    std::vector<double> cr(nroots), cx, cy;
+    for (int k = 0; k < nroots; k++) cr[k] = rad[ children[k] ];
+
+    pack_and_enclose(cr, cx, cy);
+
+    for (int k = 0; k < nroots; k++) {
+      relx[ children[k] ] = cx[k];
+      rely[ children[k] ] = cy[k];
+    }
+  }
+
+  // Top-down pass to absolute positions
+  NumericVector xs(N);
+  NumericVector ys(N);
+
+  for (int q = 0; q < N; q++) {
+    const int v = order[q];
+    const int p = parent[v] - 1;
+    xs[v] = relx[v] + (p >= 0 ? xs[p] : 0.0);
+    ys[v] = rely[v] + (p >= 0 ? ys[p] : 0.0);
+  }
+
+  return DataFrame::create(
+    Named("x") = xs,
+    Named("y") = ys,
+    Named("radius") = NumericVector(rad.begin(), rad.end()),
+    Named("depth") = IntegerVector(depth.begin(), depth.end()) );
+}
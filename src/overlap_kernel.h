@@ -0,0 +1,197 @@
+/*
+ * Vectorized search for overlapping circles.
+ *
+ * Given one circle (x, y, r) and a contiguous range of candidate circles
+ * stored as separate x, y and radius arrays, finds the first candidate
+ * whose squared centre distance is less than the squared sum of radii.
+ * This is used as a cheap pre-test before the exact (sqrt-based) overlap
+ * test in do_repulsion, so it only needs to be conservative.
+ *
+ * An AVX2 version is compiled for x86-64 and a NEON version for arm64,
+ * each for both double and float data (the float versions test twice as
+ * many circles per instruction). The version to use is chosen at run time
+ * by select_first_overlap<T>(), so the package can be built without any 
+ * special compiler flags.
+ */
+
+#ifndef PACKCIRCLES_OVERLAP_KERNEL_H
+#define PACKCIRCLES_OVERLAP_KERNEL_H
+
+// AVX2 is not used on Windows because the MinGW compilers do not align
+// the stack for 256-bit spills.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+#define PACKCIRCLES_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define PACKCIRCLES_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+// Returns the index of the first circle j in [from, to) that may overlap
+// circle (x, y, r), or `to` if there is none.
+template <typename T>
+struct FirstOverlap {
+  typedef int (*Fn)(T x, T y, T r, const T* xs, const T* ys, const T* rs,
+                    int from, int to);
+};
+
+typedef FirstOverlap<double>::Fn FirstOverlapFn;
+
+
+template <typename T>
+inline int first_overlap_scalar(T x, T y, T r,
+                                const T* xs, const T* ys, const T* rs,
+                                int from, int to) {
+  for (int j = from; j < to; j++) {
+    T dx = xs[j] - x;
+    T dy = ys[j] - y;
+    T rsum = rs[j] + r;
+    if (dx*dx + dy*dy < rsum*rsum) return j;
+  }
+  return to;
+}
+
+
+#ifdef PACKCIRCLES_HAVE_AVX2
+__attribute__((target("avx2")))
+inline int first_overlap_avx2(double x, double y, double r,
+                              const double* xs, const double* ys, const double* rs,
+                              int from, int to) {
+  const __m256d vx = _mm256_set1_pd(x);
+  const __m256d vy = _mm256_set1_pd(y);
+  const __m256d vr = _mm256_set1_pd(r);
+
+  int j = from;
+  for (; j + 4 <= to; j += 4) {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + j), vx);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + j), vy);
+    __m256d rsum = _mm256_add_pd(_mm256_loadu_pd(rs + j), vr);
+
+    __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    __m256d r2 = _mm256_mul_pd(rsum, rsum);
+
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, r2, _CMP_LT_OQ));
+    if (mask) return j + __builtin_ctz(mask);
+  }
+
+  return first_overlap_scalar(x, y, r, xs, ys, rs, j, to);
+}
+
+
+__attribute__((target("avx2")))
+inline int first_overlap_avx2_float(float x, float y, float r,
+                                    const float* xs, const float* ys, const float* rs,
+                                    int from, int to) {
+  const __m256 vx = _mm256_set1_ps(x);
+  const __m256 vy = _mm256_set1_ps(y);
+  const __m256 vr = _mm256_set1_ps(r);
+
+  int j = from;
+  for (; j + 8 <= to; j += 8) {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + j), vx);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + j), vy);
+    __m256 rsum = _mm256_add_ps(_mm256_loadu_ps(rs + j), vr);
+
+    __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 r2 = _mm256_mul_ps(rsum, rsum);
+
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, r2, _CMP_LT_OQ));
+    if (mask) return j + __builtin_ctz(mask);
+  }
+
+  return first_overlap_scalar(x, y, r, xs, ys, rs, j, to);
+}
+#endif
+
+
+#ifdef PACKCIRCLES_HAVE_NEON
+inline int first_overlap_neon(double x, double y, double r,
+                              const double* xs, const double* ys, const double* rs,
+                              int from, int to) {
+  const float64x2_t vx = vdupq_n_f64(x);
+  const float64x2_t vy = vdupq_n_f64(y);
+  const float64x2_t vr = vdupq_n_f64(r);
+
+  int j = from;
+  for (; j + 2 <= to; j += 2) {
+    float64x2_t dx = vsubq_f64(vld1q_f64(xs + j), vx);
+    float64x2_t dy = vsubq_f64(vld1q_f64(ys + j), vy);
+    float64x2_t rsum = vaddq_f64(vld1q_f64(rs + j), vr);
+
+    float64x2_t d2 = vaddq_f64(vmulq_f64(dx, dx), vmulq_f64(dy, dy));
+    uint64x2_t lt = vcltq_f64(d2, vmulq_f64(rsum, rsum));
+
+    if (vgetq_lane_u64(lt, 0)) return j;
+    if (vgetq_lane_u64(lt, 1)) return j + 1;
+  }
+
+  return first_overlap_scalar(x, y, r, xs, ys, rs, j, to);
+}
+
+
+inline int first_overlap_neon_float(float x, float y, float r,
+                                    const float* xs, const float* ys, const float* rs,
+                                    int from, int to) {
+  const float32x4_t vx = vdupq_n_f32(x);
+  const float32x4_t vy = vdupq_n_f32(y);
+  const float32x4_t vr = vdupq_n_f32(r);
+
+  int j = from;
+  for (; j + 4 <= to; j += 4) {
+    float32x4_t dx = vsubq_f32(vld1q_f32(xs + j), vx);
+    float32x4_t dy = vsubq_f32(vld1q_f32(ys + j), vy);
+    float32x4_t rsum = vaddq_f32(vld1q_f32(rs + j), vr);
+
+    float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+    uint32x4_t lt = vcltq_f32(d2, vmulq_f32(rsum, rsum));
+
+    if (vmaxvq_u32(lt)) {
+      if (vgetq_lane_u32(lt, 0)) return j;
+      if (vgetq_lane_u32(lt, 1)) return j + 1;
+      if (vgetq_lane_u32(lt, 2)) return j + 2;
+      return j + 3;
+    }
+  }
+
+  return first_overlap_scalar(x, y, r, xs, ys, rs, j, to);
+}
+#endif
+
+
+// Chooses the fastest version supported by the current CPU.
+template <typename T>
+typename FirstOverlap<T>::Fn select_first_overlap();
+
+template <>
+inline FirstOverlap<double>::Fn select_first_overlap<double>() {
+#ifdef PACKCIRCLES_HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return first_overlap_avx2;
+#endif
+
+#ifdef PACKCIRCLES_HAVE_NEON
+  return first_overlap_neon;
+#endif
+
+  return first_overlap_scalar<double>;
+}
+
+template <>
+inline FirstOverlap<float>::Fn select_first_overlap<float>() {
+#ifdef PACKCIRCLES_HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return first_overlap_avx2_float;
+#endif
+
+#ifdef PACKCIRCLES_HAVE_NEON
+  return first_overlap_neon_float;
+#endif
+
+  return first_overlap_scalar<float>;
+}
+
+#endif
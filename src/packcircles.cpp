@@ -1,5 +1,19 @@
 #define STRICT_R_HEADERS
 #include <Rcpp.h>
+#include "cell_grid.h"
+#include "circle_sizes.h"
+#include "overlap_kernel.h"
+#include "repel_layout.h"
+#include "layout_monitor.h"
+#include "layout_file.h"
+
+#include <chrono>
+#include <climits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace Rcpp;
 
 
@@ -9,55 +23,949 @@ bool almostZero(double x);
 
 bool gtZero(double x);
 
-double ordinate(double x, double lo, double hi, bool wrap);
+// Policies for keeping circle centres within the bounds. The policy is
+// chosen once per layout by run_layout, so the inner loops neither test
+// the wrap flag nor compare positions with infinite bounds.
+//
+// All four bounds infinite: positions are left as they are.
+struct NoBounds {
+  static double apply(double x, double, double) { return x; }
+};
+
+// Clamp to [lo, hi].
+struct ClampBounds {
+  static double apply(double x, double lo, double hi) {
+    return std::max(lo, std::min(hi, x));
+  }
+};
+
+// Wrap to the toroidal interval [lo, hi), which must be finite.
+struct WrapBounds {
+  static double apply(double x, double lo, double hi) {
+    const double w = hi - lo;
+    const double v = x - w * std::floor((x - lo) / w);
+    
+    // Rounding can leave v just outside the interval, e.g. when (x - lo) / w
+    // rounds up to a whole number for an x just below a multiple of w
+    return (v < lo || v >= hi) ? lo : v;
+  }
+};
+
+// Wrap when only some of the bounds are finite. An axis with an infinite
+// bound is left as it is.
+struct WrapFiniteBounds {
+  static double apply(double x, double lo, double hi) {
+    return hi - lo < INFINITY ? WrapBounds::apply(x, lo, hi) : x;
+  }
+};
+
+// Compile-time layout mode: the bounds policy, and whether all circles
+// have the same non-zero weight (so that weights need not be checked).
+template <class B, bool Uniform>
+struct LayoutMode {
+  typedef B Bounds;
+  static const bool uniform_weights = Uniform;
+};
+
+// Overlap found and movement made in one iteration of the layout.
+struct SweepStats {
+  SweepStats() : overlap(0.0), maxmove(0.0) {}
+  
+  double overlap;   // total overlap of the pairs moved apart
+  double maxmove;   // largest distance a circle was moved
+};
+
+template <typename T, class Mode>
+int do_repulsion(LayoutDataT<T>& data, int c0, int c1, 
+                 double xmin, double xmax, double ymin, double ymax,
+                 SweepStats& stats);
+
+template <typename T, class B>
+int run_layout_bounds(LayoutDataT<T>& data, std::vector<char>& active, int maxiter,
+                      double xmin, double xmax, double ymin, double ymax, 
+                      bool use_grid, int nthreads,
+                      LayoutTrace& trace, double stopoverlap, double stopmove,
+                      RepelCounters* counters, LayoutMonitor* monitor);
 
-double wrapOrdinate(double x, double lo, double hi);
+template <typename T, class Mode, bool Count>
+int run_layout_impl(LayoutDataT<T>& data, std::vector<char>& active, int maxiter,
+                    double xmin, double xmax, double ymin, double ymax, 
+                    bool use_grid, int nthreads,
+                    LayoutTrace& trace, double stopoverlap, double stopmove,
+                    RepelCounters& counters, LayoutMonitor* monitor);
 
-int do_repulsion(NumericMatrix xyr, NumericVector weights, int c0, int c1, 
-                 double xmin, double xmax, double ymin, double ymax, bool wrap);
+template <typename T, class Mode, bool Count>
+int sweep_pairwise(LayoutDataT<T>& data, typename FirstOverlap<T>::Fn first_overlap,
+                   const std::vector<char>& active, std::vector<char>& moved,
+                   double xmin, double xmax, double ymin, double ymax,
+                   SweepStats& stats, RepelCounters& counters);
+
+template <typename T, class Mode, bool Count>
+int sweep_grid(LayoutDataT<T>& data, CellGrid& grid,
+               const std::vector<char>& active, std::vector<char>& moved,
+               double xmin, double xmax, double ymin, double ymax,
+               SweepStats& stats, RepelCounters& counters);
+
+template <typename T, class Mode, bool Count>
+int sweep_parallel(LayoutDataT<T>& data, CellGrid* grid,
+                   const std::vector<char>& active, std::vector<char>& moved,
+                   double xmin, double xmax, double ymin, double ymax,
+                   int nthreads, SweepStats& stats, RepelCounters& counters);
+
+std::vector<int> active_indices(const std::vector<char>& active);
+
+std::vector<int> near_active_indices(const CellGrid& grid, 
+                                     const std::vector<char>& active);
+
+
+// Seconds from an arbitrary starting point, for timing the phases of the
+// layout when counters are requested.
+//
+static inline double seconds_now() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 
 // Attempts to position circles without overlap.
 // 
-// Given an input matrix of circle positions and sizes, attempts to position them
-// without overlap by iterating the pair-repulsion algorithm.
+// Given circle positions and sizes, attempts to position them without 
+// overlap by iterating the pair-repulsion algorithm. The input vectors are
+// not modified.
 // 
-// @param xyr 3 column matrix (centre x, centre y, radius)
+// Each iteration only compares pairs in which at least one circle is 
+// active, i.e. moved in the previous iteration (all circles are active in 
+// the first iteration), or has already moved in the current iteration. A 
+// pair of circles that was not overlapping when last compared, and neither
+// of which has moved since, cannot be overlapping now. So the layout is the
+// same as if all pairs were compared.
+// 
+// @param xs initial circle centre X ordinates
+// @param ys initial circle centre Y ordinates
+// @param sizes circle sizes. Circles with missing or non-positive sizes are
+//   ignored and will have missing values in the output.
+// @param area true if sizes are areas; false if they are radii
 // @param weights vector of double values between 0 and 1, used as multiplicative
-//   weights for the distance a circle will move with pair-repulsion.
+//   weights for the distance a circle will move with pair-repulsion. If 
+//   shorter than sizes, the last value is used for the remaining circles.
+//   Values outside [0, 1] are clamped.
 // @param xmin lower X bound
 // @param xmax upper X bound
 // @param ymin lower Y bound
 // @param ymax upper Y bound
 // @param maxiter maximum number of iterations
 // @param wrap true to allow coordinate wrapping across opposite bounds 
+// @param method either "pairwise" to compare all pairs of circles in each
+//   iteration, or "grid" to only compare circles in neighbouring cells of 
+//   a uniform grid.
+// @param nthreads number of threads to use. If 1, circles are moved one pair
+//   at a time. If greater than 1, the displacement of each circle is 
+//   calculated from the positions at the start of the iteration, in parallel,
+//   and all circles are moved at the end of the iteration. The result of the
+//   parallel version does not depend on the number of threads.
+// @param tolerance smallest overlap of two circles that will be resolved.
+// @param relative true if tolerance is relative to the smaller radius of
+//   each pair; false if it is an absolute distance.
+// @param stopoverlap stop when the total overlap of the pairs moved in an
+//   iteration is less than this.
+// @param stopmove stop when no circle moves by as much as this in an
+//   iteration.
+// @param single true to run the layout on single precision (float) copies 
+//   of the circle data, which halves the memory traffic of the pair loops
+//   and doubles the number of circles tested per SIMD instruction. The
+//   results are returned as double.
+// @param counters true to count the work done (see RepelCounters). 
+// @param timelimit maximum time in seconds for the layout iterations (Inf
+//   for no limit). The limit is checked after each iteration.
+// @param progress NULL, or an R function to be called about once a second
+//   with the number of iterations done and the number of active circles at
+//   the start of the latest iteration (see LayoutMonitor).
 //
-// @return the number of iterations performed.
+// @return a list with elements: layout, a data frame of final circle 
+//   positions and radii in input order; niter, the number of iterations 
+//   performed; nactive, an integer vector with the number of active 
+//   circles at the start of each iteration; overlap and maxmove, the total
+//   overlap of the pairs moved and the largest distance moved by a circle
+//   in each iteration; and timedout, true if the layout was stopped by the
+//   time limit. If counters is true, the
+//   counts are attached to the list as attribute "counters".
 // 
 // [[Rcpp::export]]
-int iterate_layout(NumericMatrix xyr, 
-                   NumericVector weights,
-                   double xmin, double xmax, 
-                   double ymin, double ymax,
-                   int maxiter,
-                   bool wrap) {
+List iterate_layout(NumericVector xs,
+                    NumericVector ys,
+                    NumericVector sizes,
+                    bool area,
+                    NumericVector weights,
+                    double xmin, double xmax, 
+                    double ymin, double ymax,
+                    int maxiter,
+                    bool wrap,
+                    std::string method,
+                    int nthreads,
+                    double tolerance,
+                    bool relative,
+                    double stopoverlap,
+                    double stopmove,
+                    bool single,
+                    bool counters,
+                    double timelimit,
+                    SEXP progress) {
                      
-  int rows = xyr.nrow();
+  const bool use_grid = use_grid_method(method);
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+  if (!(tolerance > 0.0)) Rcpp::stop("tolerance must be positive");
+  
+  LayoutMonitor monitor(timelimit, progress);
+  
+  const int N = sizes.length();
+  if (xs.length() != N || ys.length() != N) {
+    Rcpp::stop("xs, ys and sizes must be the same length");
+  }
+  
+  const int nw = weights.length();
+  if (nw == 0) Rcpp::stop("weights must not be empty");
+  
+  // Output columns. Circles with valid sizes are first packed at the start
+  // of these for the layout, and then moved to their input positions.
+  NumericVector outx(N);
+  NumericVector outy(N);
+  NumericVector outr(N);
+  std::vector<double> w;
+  
+  int rows = 0;
+  for (int i = 0; i < N; i++) {
+    if (valid_size(sizes[i])) {
+      outx[rows] = xs[i];
+      outy[rows] = ys[i];
+      outr[rows] = size_to_radius(sizes[i], area);
+      
+      double wt = weights[ std::min(i, nw - 1) ];
+      if (wt < 0.0) wt = 0.0;
+      else if (wt > 1.0) wt = 1.0;
+      w.push_back(wt);
+      
+      rows++ ;
+    }
+  }
+  
+  if (rows == 0) Rcpp::stop("all sizes are missing and/or non-positive");
+  if (rows < N) Rcpp::warning("missing and/or non-positive sizes will be ignored");
+  
+  LayoutTrace trace;
+  int niter = 0;
+  RepelCounters counts;
+  
+  if (rows >= 2 && single) {
+    std::vector<float> fx(outx.begin(), outx.begin() + rows);
+    std::vector<float> fy(outy.begin(), outy.begin() + rows);
+    std::vector<float> fr(outr.begin(), outr.begin() + rows);
+    std::vector<float> fw(w.begin(), w.end());
+    
+    LayoutDataF data(&fx[0], &fy[0], &fr[0], &fw[0], rows);
+    data.overlap_tol = tolerance;
+    data.relative_tol = relative;
+    std::vector<char> active(rows, 1);
+  
+    niter = run_layout(data, active, maxiter, xmin, xmax, ymin, ymax, 
+                       wrap, use_grid, nthreads, trace, stopoverlap, stopmove,
+                       counters ? &counts : NULL, &monitor);
+    
+    std::copy(fx.begin(), fx.end(), outx.begin());
+    std::copy(fy.begin(), fy.end(), outy.begin());
+  }
+  else if (rows >= 2) {
+    LayoutData data(outx.begin(), outy.begin(), outr.begin(), &w[0], rows);
+    data.overlap_tol = tolerance;
+    data.relative_tol = relative;
+    std::vector<char> active(rows, 1);
+  
+    niter = run_layout(data, active, maxiter, xmin, xmax, ymin, ymax, 
+                       wrap, use_grid, nthreads, trace, stopoverlap, stopmove,
+                       counters ? &counts : NULL, &monitor);
+  }
+  
+  // Move circles back to their input positions, working backwards so that
+  // no values are overwritten before they have been moved
+  if (rows < N) {
+    int j = rows - 1;
+    for (int i = N - 1; i >= 0; i--) {
+      if (valid_size(sizes[i])) {
+        outx[i] = outx[j];
+        outy[i] = outy[j];
+        outr[i] = outr[j];
+        j-- ;
+      } else {
+        outx[i] = NA_REAL;
+        outy[i] = NA_REAL;
+        outr[i] = NA_REAL;
+      }
+    }
+  }
+  
+  DataFrame layout = DataFrame::create(
+    _["x"] = outx,
+    _["y"] = outy,
+    _["radius"] = outr );
+  
+  List res = List::create(
+    _["layout"] = layout,
+    _["niter"] = niter,
+    _["nactive"] = IntegerVector(trace.nactive.begin(), trace.nactive.end()),
+    _["overlap"] = NumericVector(trace.overlap.begin(), trace.overlap.end()),
+    _["maxmove"] = NumericVector(trace.maxmove.begin(), trace.maxmove.end()),
+    _["timedout"] = monitor.timedout() );
+  
+  if (counters) {
+    res.attr("counters") = List::create(
+      _["pairs_tested"] = counts.pairs_tested,
+      _["pairs_moved"] = counts.pairs_moved,
+      _["time_prepare"] = counts.time_prepare,
+      _["time_compare"] = counts.time_compare,
+      _["time_update"] = counts.time_update );
+  }
+  
+  return res;
+}
+
+
+// Runs the layout on the circles in a layout file (see layout_file.h),
+// updating the x and y columns in place, so the circles are not copied 
+// into R or into separate vectors. All radii must be positive and all 
+// centres finite. This is not fully out-of-core: the weights, the working
+// arrays of run_layout (active flags, offsets and, for the grid method, 
+// the grid) are held in memory, with one element per circle.
+//
+// Other arguments are as for iterate_layout, with weights given in the
+// file row order.
+//
+// @return a list with elements niter, nactive, overlap, maxmove and 
+//   timedout, as for iterate_layout.
+//
+// [[Rcpp::export]]
+List layout_file_repel(std::string path,
+                       NumericVector weights,
+                       double xmin, double xmax, 
+                       double ymin, double ymax,
+                       int maxiter,
+                       bool wrap,
+                       std::string method,
+                       int nthreads,
+                       double tolerance,
+                       bool relative,
+                       double stopoverlap,
+                       double stopmove,
+                       double timelimit,
+                       SEXP progress) {
+  
+  const bool use_grid = use_grid_method(method);
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+  if (!(tolerance > 0.0)) Rcpp::stop("tolerance must be positive");
+  
+  const int nw = weights.length();
+  if (nw == 0) Rcpp::stop("weights must not be empty");
+  
+  LayoutFile f(path, true);
+  if (f.size() > INT_MAX) Rcpp::stop("too many circles in layout file");
+  
+  const int N = f.size();
+  const double* rs = f.radius();
+  double* xs = f.x();
+  double* ys = f.y();
+  
+  for (int i = 0; i < N; i++) {
+    if (!valid_size(rs[i])) Rcpp::stop("radii in layout file must be positive");
+    if (!std::isfinite(xs[i]) || !std::isfinite(ys[i])) {
+      Rcpp::stop("centres in layout file must be finite");
+    }
+  }
+  
+  std::vector<double> w(N);
+  for (int i = 0; i < N; i++) {
+    double wt = weights[ std::min(i, nw - 1) ];
+    w[i] = wt < 0.0 ? 0.0 : (wt > 1.0 ? 1.0 : wt);
+  }
+  
+  LayoutMonitor monitor(timelimit, progress);
+  LayoutTrace trace;
+  int niter = 0;
+  
+  if (N >= 2) {
+    LayoutData data(xs, ys, rs, &w[0], N);
+    data.overlap_tol = tolerance;
+    data.relative_tol = relative;
+    std::vector<char> active(N, 1);
+    
+    niter = run_layout(data, active, maxiter, xmin, xmax, ymin, ymax, 
+                       wrap, use_grid, nthreads, trace, stopoverlap, stopmove,
+                       NULL, &monitor);
+  }
+  
+  return List::create(
+    _["niter"] = niter,
+    _["nactive"] = IntegerVector(trace.nactive.begin(), trace.nactive.end()),
+    _["overlap"] = NumericVector(trace.overlap.begin(), trace.overlap.end()),
+    _["maxmove"] = NumericVector(trace.maxmove.begin(), trace.maxmove.end()),
+    _["timedout"] = monitor.timedout() );
+}
+
+
+template <typename T>
+int run_layout(LayoutDataT<T>& data, 
+               std::vector<char>& active,
+               int maxiter,
+               double xmin, double xmax, 
+               double ymin, double ymax,
+               bool wrap,
+               bool use_grid,
+               int nthreads,
+               LayoutTrace& trace,
+               double stopoverlap,
+               double stopmove,
+               RepelCounters* counters,
+               LayoutMonitor* monitor) {
+  
+  const bool xfinite = std::isfinite(xmin) && std::isfinite(xmax);
+  const bool yfinite = std::isfinite(ymin) && std::isfinite(ymax);
+  const bool unbounded = !std::isfinite(xmin) && !std::isfinite(xmax) &&
+                         !std::isfinite(ymin) && !std::isfinite(ymax);
+  
+  if (unbounded) {
+    return run_layout_bounds<T, NoBounds>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                          use_grid, nthreads, trace, 
+                                          stopoverlap, stopmove, counters, monitor);
+  } else if (!wrap) {
+    return run_layout_bounds<T, ClampBounds>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                             use_grid, nthreads, trace, 
+                                             stopoverlap, stopmove, counters, monitor);
+  } else if (xfinite && yfinite) {
+    return run_layout_bounds<T, WrapBounds>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                            use_grid, nthreads, trace, 
+                                            stopoverlap, stopmove, counters, monitor);
+  } else {
+    return run_layout_bounds<T, WrapFiniteBounds>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                                  use_grid, nthreads, trace, 
+                                                  stopoverlap, stopmove, counters, monitor);
+  }
+}
+
+template int run_layout<double>(LayoutData&, std::vector<char>&, int,
+                                double, double, double, double, bool, bool, int,
+                                LayoutTrace&, double, double, 
+                                RepelCounters*, LayoutMonitor*);
+
+template int run_layout<float>(LayoutDataF&, std::vector<char>&, int,
+                               double, double, double, double, bool, bool, int,
+                               LayoutTrace&, double, double, 
+                               RepelCounters*, LayoutMonitor*);
+
+
+/*
+ * Selects the layout mode for bounds policy B according to the weights,
+ * and whether to count the work done.
+ */
+template <typename T, class B>
+int run_layout_bounds(LayoutDataT<T>& data, 
+                      std::vector<char>& active,
+                      int maxiter,
+                      double xmin, double xmax, 
+                      double ymin, double ymax,
+                      bool use_grid,
+                      int nthreads,
+                      LayoutTrace& trace,
+                      double stopoverlap,
+                      double stopmove,
+                      RepelCounters* counters,
+                      LayoutMonitor* monitor) {
+  
+  bool uniform = data.n > 0 && !almostZero(data.w[0]);
+  for (int i = 1; uniform && i < data.n; i++) uniform = data.w[i] == data.w[0];
+  
+  RepelCounters unused;
+  
+  if (uniform) {
+    typedef LayoutMode<B, true> Mode;
+    if (counters) {
+      return run_layout_impl<T, Mode, true>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                            use_grid, nthreads, trace, 
+                                            stopoverlap, stopmove, *counters, monitor);
+    } else {
+      return run_layout_impl<T, Mode, false>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                             use_grid, nthreads, trace, 
+                                             stopoverlap, stopmove, unused, monitor);
+    }
+  } else {
+    typedef LayoutMode<B, false> Mode;
+    if (counters) {
+      return run_layout_impl<T, Mode, true>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                            use_grid, nthreads, trace, 
+                                            stopoverlap, stopmove, *counters, monitor);
+    } else {
+      return run_layout_impl<T, Mode, false>(data, active, maxiter, xmin, xmax, ymin, ymax,
+                                             use_grid, nthreads, trace, 
+                                             stopoverlap, stopmove, unused, monitor);
+    }
+  }
+}
+
+
+/*
+ * The layout loop for the given mode, with counting of the work done 
+ * compiled in only if Count is true.
+ */
+template <typename T, class Mode, bool Count>
+int run_layout_impl(LayoutDataT<T>& data, 
+                    std::vector<char>& active,
+                    int maxiter,
+                    double xmin, double xmax, 
+                    double ymin, double ymax,
+                    bool use_grid,
+                    int nthreads,
+                    LayoutTrace& trace,
+                    double stopoverlap,
+                    double stopmove,
+                    RepelCounters& counters,
+                    LayoutMonitor* monitor) {
+  
+  const int rows = data.n;
+  if (rows < 2) {
+    std::fill(active.begin(), active.end(), 0);
+    return 0;
+  }
+  
+  typename FirstOverlap<T>::Fn first_overlap = select_first_overlap<T>();
+  CellGrid grid;
+  
+  std::vector<char> moved(rows, 0);
   int iter;
   
   for (iter = 0; iter < maxiter; iter++) {
-    int moved = 0;
-    for (int i = 0; i < rows-1; ++i) {
-      for (int j = i+1; j < rows; ++j) {
-        if (do_repulsion(xyr, weights, i, j, xmin, xmax, ymin, ymax, wrap)) {
-          moved = 1;
+    trace.nactive.push_back( std::count(active.begin(), active.end(), 1) );
+    std::fill(moved.begin(), moved.end(), 0);
+    
+    SweepStats stats;
+    int anymoved;
+    if (nthreads > 1) {
+      anymoved = sweep_parallel<T, Mode, Count>(data, use_grid ? &grid : NULL, active, moved,
+                                                xmin, xmax, ymin, ymax, nthreads, 
+                                                stats, counters);
+    } else if (use_grid) {
+      anymoved = sweep_grid<T, Mode, Count>(data, grid, active, moved, 
+                                            xmin, xmax, ymin, ymax, stats, counters);
+    } else {
+      anymoved = sweep_pairwise<T, Mode, Count>(data, first_overlap, active, moved,
+                                                xmin, xmax, ymin, ymax, stats, counters);
+    }
+    
+    trace.overlap.push_back(stats.overlap);
+    trace.maxmove.push_back(stats.maxmove);
+    
+    active.swap(moved);
+    if (!anymoved) break;
+    
+    if (stats.overlap < stopoverlap || stats.maxmove < stopmove) {
+      iter++ ;
+      break;
+    }
+    
+    if (monitor && monitor->done(iter + 1, trace.nactive.back())) {
+      iter++ ;
+      break;
+    }
+  }
+  
+  return iter;
+}
+
+
+bool use_grid_method(const std::string& method) {
+  if (method == "pairwise") return false;
+  else if (method == "grid") return true;
+  else Rcpp::stop("Invalid method argument: " + method);
+  
+  return false;  // not reached
+}
+
+
+/*
+ * One iteration of the layout comparing every pair of circles.
+ * This is the reference version of the algorithm.
+ * 
+ * For each circle i, the vectorized first_overlap function skips over
+ * blocks of circles j > i that cannot overlap it. Only circles i and j
+ * move when a pair is repelled, so the search can resume from j + 1 and 
+ * pairs are processed exactly as if each had been passed to do_repulsion
+ * in turn. A circle that is not active, and has not yet moved in this 
+ * iteration, is only compared with circles that are active or have moved.
+ * 
+ * active  - flags for circles that moved in the previous iteration
+ * moved   - set to 1 for each circle moved in this iteration
+ * 
+ * Returns 1 if any circle was moved, 0 otherwise.
+ */
+template <typename T, class Mode, bool Count>
+int sweep_pairwise(LayoutDataT<T>& data, 
+                   typename FirstOverlap<T>::Fn first_overlap,
+                   const std::vector<char>& active,
+                   std::vector<char>& moved,
+                   double xmin, double xmax, 
+                   double ymin, double ymax,
+                   SweepStats& stats,
+                   RepelCounters& counters) {
+                     
+  const int rows = data.n;
+  int anymoved = 0;
+  
+  double t0 = Count ? seconds_now() : 0.0;
+  
+  // Sorted indices of circles that are active or have moved so far
+  std::vector<int> hot = active_indices(active);
+  
+  if (Count) {
+    double t1 = seconds_now();
+    counters.time_prepare += t1 - t0;
+    t0 = t1;
+  }
+  
+  auto mark = [&](int c) {
+    if (!moved[c]) {
+      moved[c] = 1;
+      if (!active[c]) hot.insert(std::upper_bound(hot.begin(), hot.end(), c), c);
+    }
+  };
+  
+  for (int i = 0; i < rows-1; ++i) {
+    int j = i + 1;
+    
+    // Until circle i moves, it only needs to be compared with hot circles
+    if (!active[i] && !moved[i]) {
+      j = rows;
+      for (unsigned int k = std::upper_bound(hot.begin(), hot.end(), i) - hot.begin();
+           k < hot.size(); k++) {
+        const int jhot = hot[k];
+        if (Count) counters.pairs_tested++ ;
+        
+        if (do_repulsion<T, Mode>(data, i, jhot, xmin, xmax, ymin, ymax, stats)) {
+          if (Count) counters.pairs_moved++ ;
+          mark(i);
+          mark(jhot);
+          anymoved = 1;
+          j = jhot + 1;
+          break;
+        }
+      }
+    }
+    
+    if (active[i] || moved[i]) {
+      while (j < rows) {
+        const int jstart = j;
+        j = first_overlap(data.x[i], data.y[i], data.r[i], 
+                          data.x, data.y, data.r, j, rows);
+        
+        if (Count) counters.pairs_tested += std::min(j + 1, rows) - jstart;
+        
+        if (j >= rows) break;
+        
+        if (do_repulsion<T, Mode>(data, i, j, xmin, xmax, ymin, ymax, stats)) {
+          if (Count) counters.pairs_moved++ ;
+          mark(i);
+          mark(j);
+          anymoved = 1;
         }
+        j++ ;
       }
     }
-    if (!moved) break;
   }
   
-  return iter;
+  if (Count) counters.time_compare += seconds_now() - t0;
+  
+  return anymoved;
+}
+
+
+/*
+ * One iteration of the layout using a uniform grid to find candidate
+ * pairs. The grid is rebuilt from the current positions at the start of
+ * the iteration with a cell size of twice the largest radius, so every 
+ * pair that overlaps at that point is tested. As with the pairwise 
+ * version, each circle i is compared with circles j > i and positions
+ * are updated as we go. Candidates are taken from the cells around the
+ * cell each circle was in when the grid was built.
+ * 
+ * Circles that move into new cells part way through an iteration are
+ * picked up when the grid is rebuilt at the next iteration. An iteration
+ * with no movement therefore means the same as it does for sweep_pairwise.
+ * 
+ * Only pairs including a circle that is active, or has already moved in
+ * this iteration, are compared.
+ * 
+ * In wrap mode, circles are not tested across the bounds because 
+ * do_repulsion measures distance without wrapping.
+ * 
+ * active  - flags for circles that moved in the previous iteration
+ * moved   - set to 1 for each circle moved in this iteration
+ * 
+ * Returns 1 if any circle was moved, 0 otherwise.
+ */
+template <typename T, class Mode, bool Count>
+int sweep_grid(LayoutDataT<T>& data, 
+               CellGrid& grid,
+               const std::vector<char>& active,
+               std::vector<char>& moved,
+               double xmin, double xmax, 
+               double ymin, double ymax,
+               SweepStats& stats,
+               RepelCounters& counters) {
+  
+  const int rows = data.n;
+  double t0 = Count ? seconds_now() : 0.0;
+  
+  double rmax = 0.0;
+  for (int i = 0; i < rows; i++) rmax = std::max(rmax, (double) data.r[i]);
+  
+  grid.build(data.x, data.y, rows, 2 * rmax);
+  
+  // Flags for circles that are, or are near, an active circle or one that
+  // has moved so far
+  std::vector<char> visit(rows, 0);
+  for (int i = 0; i < rows; i++) {
+    if (active[i]) grid.for_each_near_item(i, [&](int k) { visit[k] = 1; });
+  }
+  
+  auto mark = [&](int c) {
+    if (!moved[c]) {
+      moved[c] = 1;
+      if (!active[c]) grid.for_each_near_item(c, [&](int k) { visit[k] = 1; });
+    }
+  };
+  
+  int anymoved = 0;
+  std::vector<int> candidates;
+  
+  if (Count) {
+    double t1 = seconds_now();
+    counters.time_prepare += t1 - t0;
+    t0 = t1;
+  }
+  
+  for (int i = 0; i < rows-1; ++i) {
+    if (!visit[i]) continue;
+    
+    candidates.clear();
+    grid.for_each_near_item(i, [&](int j) {
+      if (j > i) candidates.push_back(j);
+    });
+    
+    // Visit candidates in index order as for sweep_pairwise
+    std::sort(candidates.begin(), candidates.end());
+    
+    for (unsigned int k = 0; k < candidates.size(); k++) {
+      const int j = candidates[k];
+      if (!active[i] && !moved[i] && !active[j] && !moved[j]) continue;
+      
+      if (Count) counters.pairs_tested++ ;
+      
+      if (do_repulsion<T, Mode>(data, i, j, xmin, xmax, ymin, ymax, stats)) {
+        if (Count) counters.pairs_moved++ ;
+        mark(i);
+        mark(j);
+        anymoved = 1;
+      }
+    }
+  }
+  
+  if (Count) counters.time_compare += seconds_now() - t0;
+  
+  return anymoved;
+}
+
+
+/*
+ * One iteration of the layout with all circles moved simultaneously.
+ * 
+ * Each circle's displacement is the sum of the displacements that 
+ * do_repulsion would give it for each overlapping circle, calculated 
+ * from the positions at the start of the iteration. Since each circle 
+ * only accumulates its own displacement, circles can be processed in
+ * parallel without locking, and the result does not depend on the number
+ * of threads. Positions are updated (and wrapped or clamped) once all
+ * displacements are known.
+ * 
+ * As for the serial versions, only pairs including an active circle are
+ * compared.
+ * 
+ * grid    - if not NULL, rebuilt and used to find candidate pairs as for
+ *           sweep_grid; otherwise all pairs are compared.
+ * active  - flags for circles that moved in the previous iteration
+ * moved   - set to 1 for each circle moved in this iteration
+ * 
+ * Returns 1 if any circle was moved, 0 otherwise.
+ */
+template <typename T, class Mode, bool Count>
+int sweep_parallel(LayoutDataT<T>& data, 
+                   CellGrid* grid,
+                   const std::vector<char>& active,
+                   std::vector<char>& moved,
+                   double xmin, double xmax, 
+                   double ymin, double ymax,
+                   int nthreads,
+                   SweepStats& stats,
+                   RepelCounters& counters) {
+  
+  const int rows = data.n;
+  double t0 = Count ? seconds_now() : 0.0;
+  T* xs = data.x;
+  T* ys = data.y;
+  const T* rs = data.r;
+  const T* ws = data.w;
+  
+  // Circles to visit: with a grid, those that are active or near an 
+  // active circle; otherwise all circles.
+  std::vector<int> visits;
+  std::vector<int> alist;
+  
+  if (grid) {
+    double rmax = 0.0;
+    for (int i = 0; i < rows; i++) rmax = std::max(rmax, (double) rs[i]);
+    grid->build(xs, ys, rows, 2 * rmax);
+    visits = near_active_indices(*grid, active);
+  } else {
+    visits.resize(rows);
+    for (int i = 0; i < rows; i++) visits[i] = i;
+    alist = active_indices(active);
+  }
+  
+  const int nvisits = visits.size();
+  std::vector<T> offx(rows, 0.0);
+  std::vector<T> offy(rows, 0.0);
+  int anymoved = 0;
+  
+  // Both circles of each pair are visited, so pairs are only counted when
+  // visiting the lower-indexed circle
+  double ntested = 0.0;
+  double nmoved = 0.0;
+  double overlap = 0.0;
+  
+  if (Count) {
+    double t1 = seconds_now();
+    counters.time_prepare += t1 - t0;
+    t0 = t1;
+  }
+  
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(nthreads) schedule(dynamic, 64) reduction(|:anymoved) reduction(+:ntested,nmoved,overlap)
+#endif
+  for (int v = 0; v < nvisits; v++) {
+    const int i = visits[v];
+    T sx = 0.0, sy = 0.0;
+    int mv = 0;
+    
+    // Accumulates the displacement of circle i due to circle j. As in
+    // do_repulsion, the lower-indexed circle of the pair is c0.
+    auto visit = [&](int j) {
+      if (j == i) return;
+      if (!active[i] && !active[j]) return;
+      
+      const int c0 = std::min(i, j);
+      const int c1 = std::max(i, j);
+      
+      if (Count && i == c0) ntested++ ;
+      
+      T dx = xs[c1] - xs[c0];
+      T dy = ys[c1] - ys[c0];
+      T r = rs[c1] + rs[c0];
+      
+      if (!(dx*dx + dy*dy < r*r)) return;
+      if (!Mode::uniform_weights && almostZero(ws[i]) && almostZero(ws[j])) return;
+      
+      T d = std::sqrt(dx*dx + dy*dy);
+      T p;
+      
+      if (r - d >= data.min_overlap(c0, c1)) {
+        if (almostZero(d)) {
+          p = 1.0;
+          dx = r - d;
+        } else {
+          p = (r - d) / d;
+        }
+        
+        if (i == c1) {
+          T w1 = (Mode::uniform_weights ? ws[0] : ws[c1]) * rs[c0] / r;
+          sx += p*dx*w1;
+          sy += p*dy*w1;
+        } else {
+          T w0 = (Mode::uniform_weights ? ws[0] : ws[c0]) * rs[c1] / r;
+          sx -= p*dx*w0;
+          sy -= p*dy*w0;
+        }
+        mv = 1;
+        
+        if (i == c0) overlap += r - d;
+        if (Count && i == c0) nmoved++ ;
+      }
+    };
+    
+    if (grid) grid->for_each_near_item(i, visit);
+    else if (active[i]) for (int j = 0; j < rows; j++) visit(j);
+    else for (unsigned int k = 0; k < alist.size(); k++) visit(alist[k]);
+    
+    offx[i] = sx;
+    offy[i] = sy;
+    moved[i] = mv;
+    anymoved |= mv;
+  }
+  
+  if (Count) {
+    double t1 = seconds_now();
+    counters.pairs_tested += ntested;
+    counters.pairs_moved += nmoved;
+    counters.time_compare += t1 - t0;
+    t0 = t1;
+  }
+  
+  stats.overlap += overlap;
+  
+  if (anymoved) {
+    double maxmove2 = 0.0;
+    for (int i = 0; i < rows; i++) {
+      maxmove2 = std::max(maxmove2, (double) (offx[i]*offx[i] + offy[i]*offy[i]));
+      xs[i] = Mode::Bounds::apply( xs[i] + offx[i], xmin, xmax );
+      ys[i] = Mode::Bounds::apply( ys[i] + offy[i], ymin, ymax );
+    }
+    stats.maxmove = std::max(stats.maxmove, sqrt(maxmove2));
+  }
+  
+  if (Count) counters.time_update += seconds_now() - t0;
+  
+  return anymoved;
+}
+
+
+/*
+ * Returns the indices of active circles in ascending order.
+ */
+std::vector<int> active_indices(const std::vector<char>& active) {
+  std::vector<int> ids;
+  for (unsigned int i = 0; i < active.size(); i++) {
+    if (active[i]) ids.push_back(i);
+  }
+  return ids;
+}
+
+
+/*
+ * Returns, in ascending order, the indices of circles that are active or
+ * are in a grid cell next to an active circle.
+ */
+std::vector<int> near_active_indices(const CellGrid& grid, 
+                                     const std::vector<char>& active) {
+  const int n = active.size();
+  std::vector<char> near(active);
+  
+  for (int i = 0; i < n; i++) {
+    if (active[i]) grid.for_each_near_item(i, [&](int j) { near[j] = 1; });
+  }
+
+  return active_indices(near);
 }
 
 
@@ -66,33 +974,43 @@ int iterate_layout(NumericMatrix xyr,
  * apart. The distance moved by each circle is proportional to the
  * radius of the other to give some semblance of intertia.
  * 
- * xyr     - 3 column matrix of circle positions and sizes (x, y, radius)
+ * data    - circle positions, sizes and weights
  * c0      - index of first circle
  * c1      - index of second circle
  * xmin    - bounds min X
  * xmax    - bounds max X
  * ymin    - bounds min Y
  * ymax    - bounds max Y
- * wrap    - allow coordinate wrapping across opposite bounds
+ * stats   - if the circles are moved, their overlap and the distance moved
+ *           are added to this
  */
-int do_repulsion(NumericMatrix xyr, 
-                 NumericVector weights,
+template <typename T, class Mode>
+int do_repulsion(LayoutDataT<T>& data,
                  int c0, int c1,
                  double xmin, double xmax, 
                  double ymin, double ymax,
-                 bool wrap) {
+                 SweepStats& stats) {
                    
+    T* x = data.x;
+    T* y = data.y;
+    const T* rad = data.r;
+    
+    T dx = x[c1] - x[c0];
+    T dy = y[c1] - y[c0];
+    T r = rad[c1] + rad[c0];
+    
+    // quick exit if the circles are not even touching
+    if (!(dx*dx + dy*dy < r*r)) return 0;
+    
     // if both weights are zero, return zero to indicate
     // no movement
-    if (almostZero(weights[c0]) && almostZero(weights[c1])) return 0;
+    if (!Mode::uniform_weights && 
+        almostZero(data.w[c0]) && almostZero(data.w[c1])) return 0;
     
-    double dx = xyr(c1, 0) - xyr(c0, 0);
-    double dy = xyr(c1, 1) - xyr(c0, 1);
-    double d = sqrt(dx*dx + dy*dy);
-    double r = xyr(c1, 2) + xyr(c0, 2);
-    double p, w0, w1;
+    T d = std::sqrt(dx*dx + dy*dy);
+    T p, w0, w1;
  
-    if (gtZero(r - d)) {
+    if (r - d >= data.min_overlap(c0, c1)) {
       if (almostZero(d)) {
         // The two centres are coincident or almost so.
         // Arbitrarily move along x-axis
@@ -102,13 +1020,16 @@ int do_repulsion(NumericMatrix xyr,
         p = (r - d) / d;
       }
 
-      w0 = weights[c0] * xyr(c1, 2) / r;
-      w1 = weights[c1] * xyr(c0, 2) / r;
+      w0 = (Mode::uniform_weights ? data.w[0] : data.w[c0]) * rad[c1] / r;
+      w1 = (Mode::uniform_weights ? data.w[0] : data.w[c1]) * rad[c0] / r;
+      
+      x[c1] = Mode::Bounds::apply( x[c1] + p*dx*w1, xmin, xmax );
+      y[c1] = Mode::Bounds::apply( y[c1] + p*dy*w1, ymin, ymax );
+      x[c0] = Mode::Bounds::apply( x[c0] - p*dx*w0, xmin, xmax );
+      y[c0] = Mode::Bounds::apply( y[c0] - p*dy*w0, ymin, ymax );
       
-      xyr(c1, 0) = ordinate( xyr(c1, 0) + p*dx*w1, xmin, xmax, wrap );
-      xyr(c1, 1) = ordinate( xyr(c1, 1) + p*dy*w1, ymin, ymax, wrap );
-      xyr(c0, 0) = ordinate( xyr(c0, 0) - p*dx*w0, xmin, xmax, wrap );
-      xyr(c0, 1) = ordinate( xyr(c0, 1) - p*dy*w0, ymin, ymax, wrap );
+      stats.overlap += r - d;
+      stats.maxmove = std::max(stats.maxmove, (double) ((r - d) * std::max(w0, w1)));
       
       return(1);
     }
@@ -116,30 +1037,6 @@ int do_repulsion(NumericMatrix xyr,
     return(0);
 }
 
-/*
- * Adjust an X or Y ordinate to the given bounds by either wrapping
- * (if `wrap` is true) or clamping (if `wrap` is false).
- */
-double ordinate(double x, double lo, double hi, bool wrap) {
-  if (wrap) return wrapOrdinate(x, lo, hi);
-  else return std::max(lo, std::min(hi, x));
-}
-
-
-/*
- * Map an X or Y ordinate to the toroidal interval [lo, hi).
- *
- * x  - X or Y ordinate to be adjusted
- * lo - lower coordinate bound
- * hi - upper coordinate bound
- */
-double wrapOrdinate(double x, double lo, double hi) {
-  double w = hi - lo;
-  while (x < lo) x += w;
-  while (x >= hi) x -= w;
-  return x;
-}
-
 bool almostZero(double x) {
   static double TOL = 0.00001;
   
@@ -40,14 +40,18 @@
 
 #define STRICT_R_HEADERS
 #include <Rcpp.h>
+#include "layout_monitor.h"
+#include <algorithm>
 #include <cmath>
 #include <complex>
-#include <map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace Rcpp;
 
-using std::map;
-using std::pair;
 using std::vector;
 using std::complex;
 
@@ -58,22 +62,127 @@ bool almostZero(double x);
 bool gtZero(double x);
 
 
-// Tests if a map contains a given key.
-template<class K, class V>
-bool contains(std::map<K, V> m, K k) {
-  return m.count(k) > 0;
+// Circle tangency graph with circles identified by dense indices 0 to N-1,
+// in ascending order of the circle IDs supplied from R.
+//
+// The neighbours (petals) of internal circle k, in cyclic order, are
+// petals[ start[k] ] to petals[ start[k+1] - 1 ]. External circles have
+// no petals.
+//
+struct PackGraph {
+  vector<int> ids;          // circle ID for each index
+  vector<char> is_internal;
+  vector<int> internal;     // indices of internal circles in ascending order
+  vector<int> start;
+  vector<int> petals;
+  vector<double> radius;
+  
+  int size() const { return ids.size(); }
+  
+  int npetals(int k) const { return start[k + 1] - start[k]; }
+  
+  const int* petals_of(int k) const { return petals.data() + start[k]; }
+  
+  // Returns the index for a circle ID, or -1 if there is no such circle.
+  int index_of(int id) const {
+    vector<int>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id) return -1;
+    return it - ids.begin();
+  }
+};
+
+
+// Builds the graph for a set of internal circles, whose neighbour IDs 
+// are nbr_ids[ nbr_start[i] ] to nbr_ids[ nbr_start[i+1] - 1 ], and a set
+// of external circles with given radii. As with the original map-based
+// version, if an ID is repeated within the internal or external circles the
+// last entry is used. Internal circles are given an initial radius of 1.
+//
+PackGraph make_graph(const vector<int>& internal_ids,
+                     const vector<int>& nbr_start,
+                     const vector<int>& nbr_ids,
+                     const vector<int>& external_ids,
+                     const vector<double>& external_radii) {
+  
+  // There should be no zero or negative values in external
+  for (unsigned int i = 0; i < external_radii.size(); i++) {
+    if (!gtZero(external_radii[i])) Rcpp::stop("external radii must be positive");
+  }
+  
+  PackGraph g;
+  g.ids = internal_ids;
+  g.ids.insert(g.ids.end(), external_ids.begin(), external_ids.end());
+  std::sort(g.ids.begin(), g.ids.end());
+  g.ids.erase(std::unique(g.ids.begin(), g.ids.end()), g.ids.end());
+  
+  const int N = g.size();
+  
+  // Position of the last entry for each circle in the internal and 
+  // external inputs
+  vector<int> int_entry(N, -1);
+  vector<int> ext_entry(N, -1);
+  for (unsigned int i = 0; i < internal_ids.size(); i++) int_entry[ g.index_of(internal_ids[i]) ] = i;
+  for (unsigned int i = 0; i < external_ids.size(); i++) ext_entry[ g.index_of(external_ids[i]) ] = i;
+  
+  g.is_internal.assign(N, 0);
+  g.radius.assign(N, 1.0);
+  g.start.assign(N + 1, 0);
+  
+  for (int k = 0; k < N; k++) {
+    if (int_entry[k] >= 0) {
+      if (ext_entry[k] >= 0) {
+        std::string msg("ID found in both internal and external map keys: ");
+        msg += Rcpp::toString(g.ids[k]);
+        Rcpp::stop(msg);
+      }
+      
+      const int e = int_entry[k];
+      g.is_internal[k] = 1;
+      g.internal.push_back(k);
+      g.start[k + 1] = nbr_start[e + 1] - nbr_start[e];
+      
+      if (g.start[k + 1] == 0) {
+        std::string msg("Internal circle has no neighbours: ");
+        msg += Rcpp::toString(g.ids[k]);
+        Rcpp::stop(msg);
+      }
+    }
+    else {
+      g.radius[k] = external_radii[ ext_entry[k] ];
+    }
+  }
+  
+  for (int k = 0; k < N; k++) g.start[k + 1] += g.start[k];
+  
+  g.petals.resize(g.start[N]);
+  for (unsigned int i = 0; i < g.internal.size(); i++) {
+    const int k = g.internal[i];
+    const int e = int_entry[k];
+    
+    for (int j = nbr_start[e]; j < nbr_start[e + 1]; j++) {
+      int p = g.index_of(nbr_ids[j]);
+      if (p < 0) {
+        std::string msg("Unknown circle ID in neighbours: ");
+        msg += Rcpp::toString(nbr_ids[j]);
+        Rcpp::stop(msg);
+      }
+      g.petals[ g.start[k] + j - nbr_start[e] ] = p;
+    }
+  }
+  
+  return g;
 }
 
 
-// Computes the angle at a circle of radius rx given by two circles of
-// radius ry and rz respectively which are tangential to circle x and
-// each other.
+// Computes the angle at circle x given by two circles y and z which are 
+// tangential to circle x and each other, from the sums of radii of each 
+// pair of circles.
 //
-double acxyz(double rx, double ry, double rz) {
-  double denom = 2 * (rx + ry) * (rx + rz);
+inline double tangent_angle(double sxy, double sxz, double syz) {
+  double denom = 2 * sxy * sxz;
   if (almostZero(denom)) return M_PI;
   
-  double num = pow(rx + ry, 2) + pow(rx + rz, 2) - pow(ry + rz, 2);
+  double num = sxy * sxy + sxz * sxz - syz * syz;
   double term = num / denom;
   
   if (term < -1.0 || term > 1.0) return M_PI / 3;
@@ -81,207 +190,436 @@ double acxyz(double rx, double ry, double rz) {
 }
 
 
-// Computes the angle sum around a given internal circle.
+// Computes the angle at a circle of radius rx given by two circles of
+// radius ry and rz respectively which are tangential to circle x and
+// each other.
+//
+double acxyz(double rx, double ry, double rz) {
+  return tangent_angle(rx + ry, rx + rz, ry + rz);
+}
+
+
+// Computes the angle sum around a given internal circle. The sum of the
+// centre radius and each petal radius is computed once and shared by the
+// two angles involving that petal.
 //
-double flower(const map<int, double>& radius, 
+double flower(const double* radius, 
               const int center, 
-              const vector<int>& cycle) {
+              const int* cycle,
+              const int nc) {
                 
-  const int nc = cycle.size();
-  const double rc = radius.at(center);
+  const double rc = radius[center];
   double sum = 0.0;
+  
+  const double r0 = radius[ cycle[0] ];
+  double ry = r0;
+  double sy = rc + ry;
 
   for (int i = 0; i < nc; i++) {
-    int j = i + 1 == nc ? 0 : i + 1;
-    sum += acxyz(rc, radius.at(cycle.at(i)), radius.at(cycle.at(j)));
+    double rz = i + 1 == nc ? r0 : radius[ cycle[i + 1] ];
+    double sz = rc + rz;
+    
+    sum += tangent_angle(sy, sz, ry + rz);
+    
+    ry = rz;
+    sy = sz;
   }
   
   return sum;
 }
 
-// Recursively find centers of all circles surrounding k.
-// The placements argument is modified in place.
+
+// Finds the centres of all circles that can be reached from the circles 
+// already placed, by working outwards breadth-first from each internal
+// circle in the queue. Each newly placed internal circle is added to the
+// queue. The placements and placed arguments are modified in place.
 //
-void place(map<int, complex<double> >& placements,
-           const map<int, double>& radii,
-           const map<int, vector<int> >& internal,
-           const int centre) {
-             
-  // If the centre circle ID is not in the internal map
-  // there is nothing to do
-  if ( !contains(internal, centre) ) return;
-
-  vector<int> cycle = internal.at(centre);  
-  const int nc = cycle.size();
-  const double rcentre = radii.at(centre);
-    
+void place(vector<complex<double> >& placements,
+           vector<char>& placed,
+           const PackGraph& g,
+           vector<int>& queue) {
+  
   const complex<double> minusI = complex<double>(0.0, -1.0);
+  
+  for (unsigned int head = 0; head < queue.size(); head++) {
+    const int centre = queue[head];
     
-  for (int i = -nc; i < nc-1; i++) { // loop indices as per Python version
-    int ks = i < 0 ? nc + i : i;
-    int s = cycle.at(ks);
-    double rs = radii.at(s);
-      
-    int kt = ks + 1 < nc ? ks + 1 : 0;
-    int t = cycle.at(kt);
-    double rt = radii.at(t);
-      
-    if ( contains(placements, s) && !contains(placements, t) ) {
-      double theta = acxyz(rcentre, rs, rt);
-      
-      complex<double> offset = (placements.at(s) - placements.at(centre)) / 
-          complex<double>(rs + rcentre);
-
-      offset = offset * exp( minusI * theta );
+    const int* cycle = g.petals_of(centre);
+    const int nc = g.npetals(centre);
+    const double rcentre = g.radius[centre];
+    
+    for (int i = -nc; i < nc-1; i++) { // loop indices as per Python version
+      int ks = i < 0 ? nc + i : i;
+      int s = cycle[ks];
+      double rs = g.radius[s];
       
-      placements[t] = placements.at(centre) + offset * (rt + rcentre);
+      int kt = ks + 1 < nc ? ks + 1 : 0;
+      int t = cycle[kt];
+      double rt = g.radius[t];
       
-      place(placements, radii, internal, t);
+      if ( placed[s] && !placed[t] ) {
+        double theta = acxyz(rcentre, rs, rt);
+        
+        // Direction from the centre to s, rotated through theta. Only the
+        // direction is used, so that small errors in earlier placements
+        // are not compounded
+        complex<double> offset = placements[s] - placements[centre];
+        offset = offset / std::abs(offset);
+        
+        offset = offset * exp( minusI * theta );
+        
+        placements[t] = placements[centre] + offset * (rt + rcentre);
+        placed[t] = 1;
+        
+        if ( g.is_internal[t] ) queue.push_back(t);
+      }
     }
   }
 }
 
-// Finds a circle packing for the given configuration of internal and 
-// external circles. 
+
+// Summary of the radius relaxation returned by relax_radii.
 //
-// The two arguments are maps with disjoint keys (integer circle IDs).
-// For the internal map, keys are internal circle IDs and values are vectors
-// of neighbouring circle IDs. For the external map, keys are external circle
-// IDs and values are radii.
+struct RelaxInfo {
+  int sweeps;        // number of sweeps over the internal circles
+  double residual;   // largest absolute angle sum error at an internal circle
+  
+  // Only recorded if counters were requested
+  int extrapolations;        // number of extrapolation steps
+  vector<double> changes;    // largest change factor in each sweep
+};
+
+
+// Divides the internal circles into classes such that no two circles in 
+// a class are neighbours, using greedy colouring in order of internal circle
+// position. Positions (in g.internal) of the circles in class c are 
+// members[ start[c] ] to members[ start[c+1] - 1 ], in ascending order.
 //
-// Returns a map with circle ID as key and pair<complex, double> values
-// representing circle centre and radius.
+// Circles j and k count as neighbours if either lists the other as a petal,
+// so that a circle is never updated in the same class as a circle whose 
+// radius it reads, even if the adjacency input is not symmetric.
 //
-std::map<int, pair<complex<double>, double> > CirclePack(
-  map<int, vector<int> > internal,
-  map<int, double> external) {
-    
-  // There should be no zero or negative values in external
-  for (map<int, double>::iterator it = external.begin(); it != external.end(); ++it) {
-    if (!gtZero(it->second)) Rcpp::stop("external radii must be positive");
+void colour_internal(const PackGraph& g, vector<int>& start, vector<int>& members) {
+  const int NI = g.internal.size();
+  const int N = g.size();
+  
+  // Reverse adjacency: the internal circles listing circle k as a petal
+  // are rev[ rev_start[k] ] to rev[ rev_start[k+1] - 1 ]
+  vector<int> rev_start(N + 1, 0);
+  for (int i = 0; i < NI; i++) {
+    const int k = g.internal[i];
+    const int* petals = g.petals_of(k);
+    for (int j = 0; j < g.npetals(k); j++) rev_start[ petals[j] + 1 ]++ ;
   }
+  for (int k = 0; k < N; k++) rev_start[k + 1] += rev_start[k];
   
-  // Copy the external map
-  map <int, double> radii( external );
-
-  for (map<int, vector<int> >::iterator it = internal.begin(); 
-       it != internal.end(); ++it) {
-         
-    if (contains(external, it->first)) {
-      std::string msg("ID found in both internal and external map keys: ");
-      msg += Rcpp::toString(it->first);
-      Rcpp::stop(msg);
+  vector<int> rev(rev_start[N]);
+  vector<int> fill(rev_start.begin(), rev_start.end() - 1);
+  for (int i = 0; i < NI; i++) {
+    const int k = g.internal[i];
+    const int* petals = g.petals_of(k);
+    for (int j = 0; j < g.npetals(k); j++) rev[ fill[ petals[j] ]++ ] = k;
+  }
+  
+  // Colour of each circle, or -1 for external and uncoloured circles
+  vector<int> colour(N, -1);
+  vector<int> used;  // used[c] == i if colour c is taken by a neighbour of i
+  int ncolours = 0;
+  
+  for (int i = 0; i < NI; i++) {
+    const int k = g.internal[i];
+    const int* petals = g.petals_of(k);
+    
+    for (int j = 0; j < g.npetals(k); j++) {
+      int c = colour[ petals[j] ];
+      if (c >= 0) used[c] = i;
+    }
+    
+    for (int j = rev_start[k]; j < rev_start[k + 1]; j++) {
+      int c = colour[ rev[j] ];
+      if (c >= 0) used[c] = i;
+    }
+    
+    int c = 0;
+    while (c < ncolours && used[c] == i) c++ ;
+    if (c == ncolours) {
+      used.push_back(-1);
+      ncolours++ ;
     }
     
-    radii[it->first] = 1.0;
+    colour[k] = c;
   }
   
-  // The main iteration for finding the correct set of radii
+  // Counting sort of positions by colour
+  start.assign(ncolours + 1, 0);
+  for (int i = 0; i < NI; i++) start[ colour[ g.internal[i] ] + 1 ]++ ;
+  for (int c = 0; c < ncolours; c++) start[c + 1] += start[c];
+  
+  members.resize(NI);
+  fill.assign(start.begin(), start.end() - 1);
+  for (int i = 0; i < NI; i++) members[ fill[ colour[ g.internal[i] ] ]++ ] = i;
+}
+
+
+// Replaces the radius of internal circle k with the value that would give
+// the desired angle sum if all neighbours had the same radius (uniform
+// neighbour model). Returns the ratio of the larger to the smaller of the
+// new and old radii, and sets change to the difference.
+//
+inline double update_radius(const PackGraph& g, double* radii, const int k, double& change) {
+  const int cycleLen = g.npetals(k);
+  
+  double theta = flower(radii, k, g.petals_of(k), cycleLen);
+  double hat = radii[k] / (1.0 / sin(theta / (2*cycleLen)) - 1);
+  double newrad = hat * (1.0 / sin(M_PI / cycleLen) - 1);
+  
+  double kc = std::max(newrad / radii[k], radii[k] / newrad);
+  change = newrad - radii[k];
+  radii[k] = newrad;
+  return kc;
+}
+
+
+// Iteratively adjusts the radii of internal circles until the angle sum
+// at each is 2 pi, updating the radii in the graph.
+//
+// Each sweep visits the internal circles in order and updates each radius
+// with update_radius. Iteration stops when no radius changes by more than
+// a factor of Tolerance in a sweep.
+//
+// If nthreads is greater than 1, each sweep instead updates the circles
+// one colour class at a time (see colour_internal), with the circles in a
+// class updated in parallel. Since no two circles in a class are 
+// neighbours, the result does not depend on the number of threads, but it
+// differs slightly from a single-threaded run due to the different order
+// of updates.
+//
+// If accelerate is true, the sweeps are combined with the extrapolation
+// step described by Collins & Stephenson (2003): when the size of 
+// successive changes to the radii is shrinking at a steady rate lambda, 
+// the radii are moved further along the latest direction of change by 
+// lambda / (1 - lambda) times that change, which is where the sweeps 
+// would take them in the limit. The step is shortened if needed so no
+// radius falls below half its current value.
+//
+// If counters is true, the extrapolations and changes fields of the 
+// returned RelaxInfo are filled in. If monitor is not NULL, it is called
+// after each sweep with the largest change factor, and iteration stops 
+// early if it returns true. The radii are then left as they are, which 
+// includes the extrapolation step if one was made after the latest sweep.
+//
+template <bool Count>
+RelaxInfo relax_radii_impl(PackGraph& g, bool accelerate, int nthreads,
+                           LayoutMonitor* monitor);
+
+RelaxInfo relax_radii(PackGraph& g, bool accelerate, int nthreads, bool counters,
+                      LayoutMonitor* monitor) {
+  return counters ? relax_radii_impl<true>(g, accelerate, nthreads, monitor) :
+                    relax_radii_impl<false>(g, accelerate, nthreads, monitor);
+}
+
+template <bool Count>
+RelaxInfo relax_radii_impl(PackGraph& g, bool accelerate, int nthreads,
+                           LayoutMonitor* monitor) {
+  double* radii = &g.radius[0];
+  const int NI = g.internal.size();
+  const int* internal = &g.internal[0];
+  
+  vector<int> colour_start;
+  vector<int> colour_members;
+  if (nthreads > 1) colour_internal(g, colour_start, colour_members);
+  const int ncolours = colour_start.empty() ? 0 : colour_start.size() - 1;
+  
+  vector<double> delta(NI, 0.0);
+  vector<double> ratio(NI, 1.0);
+  double* pdelta = &delta[0];
+  double* pratio = &ratio[0];
+  
+  double c0 = 0.0;        // size of the change in the previous sweep
+  double lambda0 = 0.0;   // previous rate of reduction in change size
+  bool extrapolated = false;
+  
+  RelaxInfo info;
+  info.sweeps = 0;
+  info.extrapolations = 0;
+  
   double lastChange = Tolerance + 1;
   while (lastChange > Tolerance) {
+    if (ncolours == 0) {
+      for (int i = 0; i < NI; i++) {
+        ratio[i] = update_radius(g, radii, internal[i], delta[i]);
+      }
+    }
+    else {
+      for (int c = 0; c < ncolours; c++) {
+        const int* members = &colour_members[0] + colour_start[c];
+        const int n = colour_start[c + 1] - colour_start[c];
+        
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+        for (int j = 0; j < n; j++) {
+          const int i = members[j];
+          pratio[i] = update_radius(g, radii, internal[i], pdelta[i]);
+        }
+      }
+    }
+    
+    // Largest ratio of new to old radius, and size of the change
     lastChange = 1.0;
-    for (map<int, vector<int> >::iterator it = internal.begin(); 
-       it != internal.end(); ++it) {
+    double c1 = 0.0;
+    for (int i = 0; i < NI; i++) {
+      lastChange = std::max(lastChange, ratio[i]);
+      c1 += delta[i] * delta[i];
+    }
     
-      int k = it->first;
-      vector<int>& cycle = it->second;
-      int cycleLen = cycle.size();
+    info.sweeps++ ;
+    if (Count) info.changes.push_back(lastChange);
+    c1 = sqrt(c1);
+    
+    if (accelerate && lastChange > Tolerance) {
+      // The rate estimate is only used if it was also seen over the 
+      // previous pair of sweeps, with no extrapolation in between.
+      double lambda = c0 > 0.0 ? c1 / c0 : 1.0;
       
-      double theta = flower(radii, k, cycle);
-      double hat = radii[k] / (1.0 / sin(theta / (2*cycleLen)) - 1);
-      double newrad = hat * (1.0 / sin(M_PI / cycleLen) - 1);
-
-      double kc = std::max(newrad / radii[k], radii[k] / newrad);
-      lastChange = std::max(lastChange, kc);
+      if (!extrapolated && lambda < 1.0 && fabs(lambda - lambda0) < 0.1 * (1.0 - lambda)) {
+        double factor = lambda / (1.0 - lambda);
+        
+        for (int i = 0; i < NI; i++) {
+          if (delta[i] < 0.0) {
+            factor = std::min(factor, -0.5 * radii[ internal[i] ] / delta[i]);
+          }
+        }
+        
+        for (int i = 0; i < NI; i++) radii[ internal[i] ] += factor * delta[i];
+        extrapolated = true;
+        if (Count) info.extrapolations++ ;
+      }
+      else {
+        extrapolated = false;
+      }
       
-      radii[k] = newrad;
+      lambda0 = lambda;
     }
-  }    
     
-  // Recursively place all the circles
-  map<int, complex<double> > placements;
+    c0 = c1;
+    
+    if (monitor && lastChange > Tolerance && monitor->done(info.sweeps, lastChange)) break;
+  }
+  
+  info.residual = 0.0;
+  for (int i = 0; i < NI; i++) {
+    const int k = internal[i];
+    double err = fabs(flower(radii, k, g.petals_of(k), g.npetals(k)) - 2 * M_PI);
+    info.residual = std::max(info.residual, err);
+  }
+  
+  return info;
+}
+
+
+// Finds a circle packing for the given graph. Radii of internal circles
+// are updated in the graph, and circle centres are returned. Any circles
+// that cannot be reached from the first internal circle are left at the
+// origin.
+//
+vector<complex<double> > CirclePack(PackGraph& g, bool accelerate, int nthreads, 
+                                    bool counters, LayoutMonitor* monitor, 
+                                    RelaxInfo& info) {
+  if (g.internal.empty()) Rcpp::stop("there must be at least one internal circle");
+  
+  info = relax_radii(g, accelerate, nthreads, counters, monitor);
+  const double* radii = &g.radius[0];
     
-  int k1 = internal.begin()->first; // pick one internal circle
-  placements[k1] = complex<double>(0.0);    // place it at the origin
+  // Place all the circles
+  vector<complex<double> > placements(g.size(), complex<double>(0.0));
+  vector<char> placed(g.size(), 0);
     
-  int k2 = internal[k1].at(0);      // pick one of its neighbors
-  placements[k2] = complex<double>(radii[k1] + radii[k2]);  // place it on the real axis
-  place(placements, radii, internal, k1);  // recursively place the rest
-  place(placements, radii, internal, k2);
+  int k1 = g.internal[0];          // pick one internal circle
+  placed[k1] = 1;                  // place it at the origin
 
-  map<int, pair<complex<double>, double> > out;
-  for (map<int, double>::iterator it = radii.begin(); it != radii.end(); ++it) {
-    int k = it->first;
-    out[k] = pair<complex<double>, double>(placements[k], radii[k]);
-  }
+  int k2 = g.petals_of(k1)[0];     // pick one of its neighbors
+  placements[k2] = complex<double>(radii[k1] + radii[k2]);  // place it on the real axis
+  placed[k2] = 1;
+  
+  vector<int> queue;               // place the rest working outwards
+  queue.reserve(g.internal.size());
+  queue.push_back(k1);
+  if ( g.is_internal[k2] ) queue.push_back(k2);
   
-  return out;
+  place(placements, placed, g, queue);
+
+  return placements;
 }
 
 
 // Finds a circle packing for the given configuration of internal and 
 // external circles. This is the interface function for R.
 //
-// The two arguments are maps with disjoint keys (integer circle IDs).
-// For the internal map, keys are internal circle IDs and values are vectors
-// of neighbouring circle IDs. For the external map, keys are external circle
-// IDs and values are radii.
+// internalList is a list of vectors where, in each vector, the first
+// element is circle ID and the remaining elements are IDs of the 
+// neighbouring circles. externalDF is a data frame with columns for
+// circle ID and radius. Internal and external circle IDs must be disjoint.
+// If accelerate is true, extrapolation is used to speed up the relaxation
+// of internal circle radii. nthreads is the number of threads to use for 
+// the relaxation. If counters is true, the relaxation sweeps, extrapolation
+// steps and the largest change factor in each sweep are recorded. timelimit 
+// is the maximum time in seconds for the relaxation (Inf for no limit), and
+// progress is NULL or an R function to be called about once a second with
+// the number of sweeps done and the largest change factor in the latest 
+// sweep (see LayoutMonitor).
 //
 // Returns a List (attributed as a data.frame for R) with columns for circle ID,
-// centre X, centre Y and radius.
+// centre X, centre Y and radius. The number of relaxation sweeps and the
+// largest remaining angle sum error are attached as attributes "niter" and
+// "residual", whether the relaxation was stopped by the time limit as 
+// attribute "timedout", and any counts as attribute "counters".
 //
 // [[Rcpp::export]]
-List doCirclePack(List internalList, DataFrame externalDF) {
+List doCirclePack(List internalList, DataFrame externalDF, bool accelerate, int nthreads,
+                  bool counters, double timelimit, SEXP progress) {
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+
+  
+  vector<int> internal_ids;
+  vector<int> nbr_start(1, 0);
+  vector<int> nbr_ids;
   
-  // internalList is a list of vectors where, in each vector,
-  // the first element is circle ID and the remaining elements are
-  // IDs of the neighbouring circles.
-  map<int, vector<int> > internal;
   for (int i = 0; i < internalList.size(); i++) {
     IntegerVector v = internalList(i);
-    int id = v(0);
-    
-    vector<int> nbrs;
-    for (int j = 1; j < v.size(); j++) nbrs.push_back(v(j));
+    internal_ids.push_back( v(0) );
     
-    internal[id] = nbrs;
+    for (int j = 1; j < v.size(); j++) nbr_ids.push_back(v(j));
+    nbr_start.push_back(nbr_ids.size());
   }
   
-  // externalDF is a DataFrame with cols ID (int) and radius (double)
-  map<int, double> external;
-  IntegerVector ids = externalDF[0];
-  NumericVector radii = externalDF[1];
+  IntegerVector ext_ids = externalDF[0];
+  NumericVector ext_radii = externalDF[1];
   
-  for (int i = 0; i < ids.size(); i++) {
-    external[ ids[i] ] = radii[i];
-  }
-
-  std::map<int, pair<complex<double>, double> > packing( CirclePack(internal, external) );
+  PackGraph g = make_graph(internal_ids, nbr_start, nbr_ids,
+                           vector<int>(ext_ids.begin(), ext_ids.end()),
+                           vector<double>(ext_radii.begin(), ext_radii.end()));
+  
+  LayoutMonitor monitor(timelimit, progress);
+  
+  RelaxInfo info;
+  vector<complex<double> > centres = CirclePack(g, accelerate, nthreads, counters, 
+                                                &monitor, info);
 
-  int N = packing.size();
+  const int N = g.size();
   
-  int k = 0;
   IntegerVector out_ids(N);
   NumericVector out_xs(N);
   NumericVector out_ys(N);
   NumericVector out_radii(N);
   StringVector  out_rownames(N);
 
-  for (map<int, pair<complex<double>, double> >::iterator it = packing.begin();
-       it != packing.end(); ++it) {
-         
-    out_ids(k) = it->first;
-    
-    std::complex<double> c = it->second.first;
-    out_xs(k) = c.real();
-    out_ys(k) = c.imag();
-    
-    double r = it->second.second;
-    out_radii(k) = r;
-    
+  for (int k = 0; k < N; k++) {
+    out_ids(k) = g.ids[k];
+    out_xs(k) = centres[k].real();
+    out_ys(k) = centres[k].imag();
+    out_radii(k) = g.radius[k];
     out_rownames(k) = Rcpp::toString(k+1);
-    
-    k++ ;
   }
   
   List out_frame = List::create(
@@ -292,6 +630,16 @@ List doCirclePack(List internalList, DataFrame externalDF) {
     
   out_frame.attr("class") = "data.frame";
   out_frame.attr("row.names") = out_rownames;
+  out_frame.attr("niter") = info.sweeps;
+  out_frame.attr("residual") = info.residual;
+  out_frame.attr("timedout") = monitor.timedout();
+  
+  if (counters) {
+    out_frame.attr("counters") = List::create(
+      _["sweeps"] = info.sweeps,
+      _["extrapolations"] = info.extrapolations,
+      _["max_change"] = NumericVector(info.changes.begin(), info.changes.end()) );
+  }
   
   return out_frame;
 }
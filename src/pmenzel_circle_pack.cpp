@@ -57,69 +57,123 @@
 
 #define STRICT_R_HEADERS
 #include <Rcpp.h>
+#include "circle_sizes.h"
+#include "layout_file.h"
+#include "progressive_layout.h"
+#include <algorithm>
 #include <float.h>
-using namespace Rcpp;
+#include <queue>
+#include <vector>
 
-const double INTERSECTION_TOL = 1.0e-4;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+using namespace Rcpp;
 
-class Node {
+// Index of the nodes in the front chain ordered by distance from the
+// origin, used to find the nearest node without walking the whole chain.
+//
+// Nodes only ever leave the chain when they are spliced out, and never
+// return, so removed nodes are simply flagged and discarded when they
+// reach the top of the heap.
+//
+class FrontIndex {
 public:
-  Node() { init(); }
+  FrontIndex(NodePool& pool_) : pool(pool_) {}
   
-  Node(double r_) {
-    init();
-    radius = r_;
+  void add(int i) {
+    Node& n = pool[i];
+    n.onfront = true;
+    
+    // Nodes that the linear search could never select are not indexed
+    double dist = sqrt(n.x * n.x + n.y * n.y);
+    if (dist < FLT_MAX) heap.push(Entry(dist, i));
   }
   
-  void init() {
-    x = 0.0;
-    y = 0.0;
-    radius = 0.0;
-    next = NULL;
-    prev = NULL;
-    insertnext = NULL;
+  // Flags the nodes after `from`, up to but not including `to`, as
+  // removed. Called before splicing `from` to `to`. Returns the number of
+  // nodes removed.
+  int remove_between(int from, int to) {
+    int n = 0;
+    for (int i = pool[from].next; i != to; i = pool[i].next, n++) pool[i].onfront = false;
+    return n;
   }
   
-  // Check for intersection with another node
-  bool intersects(Node* n) {
-    double dx = x - n->x;
-    double dy = y - n->y;
-    double dr = radius + n->radius;
+  // Returns the front node nearest the origin. Where several nodes are 
+  // equally near, returns the first one found walking the chain forward
+  // from `start`, as the original linear search did. Returns `start` if
+  // no node is indexed.
+  int nearest(int start) {
+    discard_removed();
+    if (heap.empty()) return start;
+    
+    Entry top = heap.top();
+    heap.pop();
+    discard_removed();
+    
+    if (heap.empty() || heap.top().first != top.first) {
+      heap.push(top);
+      return top.second;
+    }
+    
+    // Tied distances (rare): collect all tied nodes and take the first
+    // one in chain order.
+    std::vector<Entry> tied(1, top);
+    while (!heap.empty() && heap.top().first == top.first) {
+      tied.push_back(heap.top());
+      heap.pop();
+      discard_removed();
+    }
     
-    return ((dr * dr - dx * dx - dy * dy) > INTERSECTION_TOL);
+    int found = NO_NODE;
+    int i = start;
+    do {
+      for (unsigned int k = 0; k < tied.size() && found == NO_NODE; k++) {
+        if (tied[k].second == i) found = i;
+      }
+      i = pool[i].next;
+    } while (found == NO_NODE && i != start);
+    
+    for (unsigned int k = 0; k < tied.size(); k++) heap.push(tied[k]);
+    
+    return found != NO_NODE ? found : top.second;
   }
   
-  // Place this node after node `a`
-  void place_after(Node *a) {
-    Node *n = a->next;
-    a->next = this;
-    this->prev = a;
-    this->next = n;
-    if (n) n->prev = this;
+  // Rebuilds the index from the nodes flagged as on the front, e.g. after
+  // the pool has been compacted.
+  void rebuild() {
+    heap = Heap();
+    for (int i = 0; i < pool.size(); i++) {
+      if (pool[i].onfront) add(i);
+    }
   }
   
-  // Splice this node before node `a`
-  void splice(Node *a) {
-    this->next = a;
-    a->prev = this;
+private:
+  typedef std::pair<double, int> Entry;
+  
+  struct EntryGreater {
+    bool operator()(const Entry& e1, const Entry& e2) const {
+      return e1.first > e2.first;
+    }
+  };
+  
+  void discard_removed() {
+    while (!heap.empty() && !pool[heap.top().second].onfront) heap.pop();
   }
-
-  double radius;
-  double x;
-  double y;
   
-  Node* next;
-  Node* prev;
-  Node* insertnext;
+  typedef std::priority_queue<Entry, std::vector<Entry>, EntryGreater> Heap;
+  
+  NodePool& pool;
+  Heap heap;
 };
 
 
-void place_circle(Node* a, Node* b, Node* c) {
-  double da = b->radius + c->radius;
-  double db = a->radius + c->radius;
-  double dx = b->x - a->x;
-  double dy = b->y - a->y;
+void place_circle(const Node& a, const Node& b, Node& c) {
+  double da = b.radius + c.radius;
+  double db = a.radius + c.radius;
+  double dx = b.x - a.x;
+  double dy = b.y - a.y;
   double dc = sqrt(dx * dx + dy * dy);
   if (dc > 0.0) {
     double cos = (db * db + dc * dc - da * da) / (2 * db * dc);
@@ -129,163 +183,534 @@ void place_circle(Node* a, Node* b, Node* c) {
     dx /= dc;
     dy /= dc;
     
-    c->x = a->x + x * dx + h * dy;
-    c->y = a->y + x * dy - h * dx;
+    c.x = a.x + x * dx + h * dy;
+    c.y = a.y + x * dy - h * dx;
   }
   else {
-    c->x = a->x + db;
-    c->y = a->y;
+    c.x = a.x + db;
+    c.y = a.y;
   }
 }
 
 
-void place_circles(Node* firstnode) {
-  Node * a = firstnode;
-  Node * b = NULL;
-  Node * c = NULL;
+// State of the progressive layout between placements: the front chain of
+// placed circles, indexed by distance from the origin. Circles are placed
+// one at a time, so the layout can be run over a whole pool at once or fed
+// with circles as they arrive, with the same result. Counting of the work
+// done is compiled in only if Count is true.
+//
+template <bool Count>
+class FrontChain {
+public:
+  FrontChain(NodePool& nodes_, PlaceCounters& counters_) :
+    nodes(nodes_), front(nodes_), counters(counters_),
+    nplaced(0), first(NO_NODE), second(NO_NODE), a(NO_NODE),
+    front_length(0), max_front_length(0) {}
   
-  // First circle
-  a->x = -1 * a->radius;
-
-  // Second circle
-  if(!a->insertnext) return;
-  b = a->insertnext;
-  b->x = b->radius;
-  b->y = 0;
-
-  // Third circle
-  if(!b->insertnext) return;
-  c = b->insertnext;
-  place_circle(a, b, c);  
-  if (!c->insertnext) return;
-    
-  // Initial node chain
-  // -> a <--> c <--> b <-
-  a->next = c;
-  a->prev = b;
-  b->next = a;
-  b->prev = c;
-  c->next = b;
-  c->prev = a;
-  b = c;
-  
-  c = c->insertnext;
-  bool skip = false;
-  
-  while(c) {
-    // pmenzel's comment:
-    // Determine the node a in the chain, which is nearest to the center
-    // The new node c will be placed next to a (unless overlap occurs)
-    // NB: This search is only done the first time for each new node, i.e.
-    // not again after splicing.
-    if(!skip) {
-      Node* n = a;
-      Node* nearestnode = n;
-      double nearestdist = FLT_MAX;
+  
+  // Places node c around the circles placed so far.
+  void place(int c) {
+    switch (nplaced++) {
+    case 0:
+      // First circle
+      nodes[c].x = -1 * nodes[c].radius;
+      first = c;
+      front_length = 1;
+      break;
       
-      do {
-        double dist_n = sqrt(n->x * n->x + n->y * n->y);
-        if(dist_n < nearestdist) {	
-          nearestdist = dist_n;
-          nearestnode = n;
-        }
-        n = n->next;
-      } while(n != a);
+    case 1:
+      // Second circle
+      nodes[c].x = nodes[c].radius;
+      nodes[c].y = 0;
+      second = c;
+      front_length = 2;
+      break;
+      
+    case 2:
+      // Third circle and initial node chain
+      // -> first <--> c <--> second <-
+      place_circle(nodes[first], nodes[second], nodes[c]);
+      
+      nodes[first].next = c;
+      nodes[first].prev = second;
+      nodes[second].next = first;
+      nodes[second].prev = c;
+      nodes[c].next = second;
+      nodes[c].prev = first;
       
-      a = nearestnode; 
-      b = nearestnode->next;
-      skip=false;
+      front.add(first);
+      front.add(c);
+      front.add(second);
+      a = first;
+      front_length = 3;
+      break;
+      
+    default:
+      place_next(c);
     }
     
-    place_circle(a, b, c);
-    
-    // Search for possible closest intersection
-    bool isect = false;
-    Node* j = b->next;
-    Node* k = a->prev;
+    max_front_length = std::max(max_front_length, front_length);
+  }
+  
+  
+  // Removes nodes that have left the front chain from the pool, which 
+  // renumbers the remaining nodes. Only possible once the chain has been
+  // formed.
+  void compact() {
+    if (nplaced < 3) return;
     
-    double sj = b->radius;
-    double sk = a->radius;
+    std::vector<int> newidx = nodes.keep_front();
+    a = newidx[a];
+    front.rebuild();
+  }
+  
+  
+  // Adds the front chain lengths to the counters. Called when done.
+  void finish() {
+    if (Count) {
+      counters.front_length += front_length;
+      counters.max_front_length = std::max(counters.max_front_length, (double) max_front_length);
+    }
+  }
+  
+  
+  // Number of nodes in the front chain
+  int length() const { return front_length; }
+  
+  
+private:
+  void place_next(int c) {
+    bool skip = false;
+    int b = NO_NODE;
     
-    do {
-      if (sj <= sk) {
-        if ( j->intersects(c) ) {
-          a->splice(j);
-          b = j;
-          skip = true;
-          isect = true;
-          break;
-        }
-        sj += j->radius;
-        j = j->next;
+    while (true) {
+      // pmenzel's comment:
+      // Determine the node a in the chain, which is nearest to the center
+      // The new node c will be placed next to a (unless overlap occurs)
+      // NB: This search is only done the first time for each new node, i.e.
+      // not again after splicing.
+      if(!skip) {
+        a = front.nearest(a);
+        b = nodes[a].next;
       }
-      else {
-        if( c->intersects(k) ) {
-          k->splice(b);
-          a = k;
-          skip = true;
-          isect = true;
-          break;
+      
+      place_circle(nodes[a], nodes[b], nodes[c]);
+      
+      // Search for possible closest intersection
+      bool isect = false;
+      int j = nodes[b].next;
+      int k = nodes[a].prev;
+      
+      double sj = nodes[b].radius;
+      double sk = nodes[a].radius;
+      
+      do {
+        if (Count) counters.search_steps++ ;
+        
+        if (sj <= sk) {
+          if ( nodes[j].intersects(nodes[c]) ) {
+            front_length -= front.remove_between(a, j);
+            if (Count) counters.splices++ ;
+            nodes.splice(a, j);
+            b = j;
+            skip = true;
+            isect = true;
+            break;
+          }
+          sj += nodes[j].radius;
+          j = nodes[j].next;
         }
-        sk += k->radius;
-        k = k->prev;
+        else {
+          if( nodes[c].intersects(nodes[k]) ) {
+            front_length -= front.remove_between(k, b);
+            if (Count) counters.splices++ ;
+            nodes.splice(k, b);
+            a = k;
+            skip = true;
+            isect = true;
+            break;
+          }
+          sk += nodes[k].radius;
+          k = nodes[k].prev;
+        }
+      } while (j != nodes[k].next);
+      
+      // Update the node chain
+      if(!isect) {
+        nodes.place_after(c, a);
+        front.add(c);
+        front_length++ ;
+        return;
       }
-    } while (j != k->next);
+    }
+  }
+  
+  NodePool& nodes;
+  FrontIndex front;
+  PlaceCounters& counters;
+  
+  int nplaced;
+  int first;    // first two circles placed, until the chain is formed
+  int second;
+  int a;        // node the last circle was placed next to
+  
+  int front_length;
+  int max_front_length;
+};
+
+
+template <bool Count>
+void place_circles_impl(NodePool& nodes, PlaceCounters& counters);
+
+
+void place_circles(NodePool& nodes, PlaceCounters* counters) {
+  if (counters) {
+    place_circles_impl<true>(nodes, *counters);
+  } else {
+    PlaceCounters unused;
+    place_circles_impl<false>(nodes, unused);
+  }
+}
+
+
+// The progressive layout of all nodes in the pool, in order.
+//
+template <bool Count>
+void place_circles_impl(NodePool& nodes, PlaceCounters& counters) {
+  FrontChain<Count> chain(nodes, counters);
+  
+  for (int c = 0; c < nodes.size(); c++) chain.place(c);
+  
+  chain.finish();
+}
+
+
+// Smallest node pool that ProgressiveStream will compact
+const int MinCompact = 1024;
+
+
+// Progressive layout of circles that arrive in chunks, e.g. from a feed
+// too large to hold in memory at once. Each circle is placed as it 
+// arrives, exactly as it would be by place_circles with all circles.
+//
+// Circles that have left the front chain can never be touched again, so
+// they are dropped from the pool once it holds more than twice as many
+// nodes as the chain (and at least MinCompact). Memory use therefore 
+// depends on the length of the chain rather than the number of circles.
+//
+class ProgressiveStream {
+public:
+  ProgressiveStream() : chain(nodes, unused), nplaced(0) {}
+  
+  // Places circles with the given sizes (areas if area is true, otherwise
+  // radii), writing their centres and radii to xs, ys and rs. Circles with
+  // missing or non-positive sizes are skipped and have missing values in 
+  // the output. Returns the number of circles placed.
+  int add(const double* sizes, int n, bool area, double* xs, double* ys, double* rs) {
+    int placed = 0;
     
-    // Update the node chain
-    if(!isect) {
-      c->place_after(a);
-      b = c;
+    for (int i = 0; i < n; i++) {
+      if (!valid_size(sizes[i])) {
+        xs[i] = ys[i] = rs[i] = NA_REAL;
+        continue;
+      }
       
-      skip = false;
+      const int c = nodes.add( size_to_radius(sizes[i], area) );
+      chain.place(c);
       
-      c = c->insertnext;
+      xs[i] = nodes[c].x;
+      ys[i] = nodes[c].y;
+      rs[i] = nodes[c].radius;
+      placed++ ;
+      
+      if (nodes.size() > std::max(MinCompact, 2 * chain.length())) chain.compact();
     }
+    
+    nplaced += placed;
+    return placed;
   }
+  
+  // Total number of circles placed
+  double size() const { return nplaced; }
+  
+  // Number of nodes currently stored
+  int stored() const { return nodes.size(); }
+  
+private:
+  NodePool nodes;
+  PlaceCounters unused;
+  FrontChain<false> chain;
+  double nplaced;
+};
+
+
+// Progressive layout of circles with the given radii, writing the centre
+// coordinates to xs and ys. Returns the number of circles.
+//
+static int layout_to_buffers(const NumericVector& radii, double* xs, double* ys) {
+  const int N = radii.length();
+  
+  NodePool nodes(radii.begin(), N);
+  place_circles(nodes);
+  
+  for (int i = 0; i < N; i++) {
+    xs[i] = nodes[i].x;
+    ys[i] = nodes[i].y;
+  }
+  
+  return N;
 }
 
 
+// Progressive layout of circles with the given radii.
+//
+// @return a data frame of circle positions and radii. The radii vector is
+//   not modified.
+//
 // [[Rcpp::export]]
 DataFrame do_progressive_layout(NumericVector radii) {
   int N = radii.length();
   
-  Node *node = new Node(radii(0));
-  Node *firstnode = node;
-  Node *lastinsertednode = node;
+  NumericVector xs(N);
+  NumericVector ys(N);
+  layout_to_buffers(radii, xs.begin(), ys.begin());
 
-  for (int i = 1; i < N; i++) {
-    node = new Node(radii[i]);
-    lastinsertednode->insertnext = node;
-    
-    lastinsertednode = node;
+  return DataFrame::create(
+    Named("x") = xs,
+    Named("y") = ys,
+    Named("radius") = radii);
+}
+
+
+// Progressive layout of circles with the given radii, writing the circle 
+// centres into the existing vectors xs and ys rather than allocating new 
+// ones. This is intended for calling repeatedly with same-sized arrays,
+// e.g. for each frame of an animation.
+//
+// xs and ys must be double vectors of the same length as radii. They are
+// modified in place, bypassing R's copy-on-modify semantics, so they must
+// not be shared with any other R object: any other variable referring to
+// the same vector would see the new values. Callers should pass vectors
+// they have just allocated, e.g. with numeric(n). The radii vector is not
+// modified.
+//
+// For this reason the function is only exported to R under the internal
+// name .progressive_layout_into, and is not part of the package API.
+//
+// @return the number of circles laid out.
+//
+// [[Rcpp::export(.progressive_layout_into)]]
+int do_progressive_layout_into(NumericVector radii, SEXP xs, SEXP ys) {
+  if (TYPEOF(xs) != REALSXP || TYPEOF(ys) != REALSXP) {
+    Rcpp::stop("xs and ys must be double vectors");
   }
   
-  place_circles(firstnode);
+  NumericVector outx(xs);
+  NumericVector outy(ys);
   
-  NumericVector xs(N);
-  NumericVector ys(N);
+  if (outx.length() != radii.length() || outy.length() != radii.length()) {
+    Rcpp::stop("xs and ys must be the same length as radii");
+  }
+  
+  return layout_to_buffers(radii, outx.begin(), outy.begin());
+}
+
+
+// Progressive layout of circles, optionally divided into independent 
+// groups, taking sizes directly from R. The input vectors are not modified.
+//
+// @param sizes circle sizes. Circles with missing or non-positive sizes are
+//   ignored and will have missing values in the output.
+// @param area true if sizes are areas; false if they are radii.
+// @param groups group codes (1 to ngroups) for each circle, or an empty 
+//   vector to lay out all circles as a single group.
+// @param ngroups number of groups (ignored if groups is empty).
+// @param nthreads number of threads to use; groups are laid out in 
+//   parallel.
+// @param counters true to count the work done (see PlaceCounters).
+//
+// @return a data frame of circle positions and radii in the same order as
+//   the input, with each group laid out separately around the origin. If
+//   counters is true, the counts, summed over groups (except for
+//   max_front_length, which is the largest in any group), are attached as
+//   attribute "counters".
+//
+// [[Rcpp::export]]
+DataFrame do_progressive_layout_sizes(NumericVector sizes,
+                                      bool area,
+                                      IntegerVector groups,
+                                      int ngroups,
+                                      int nthreads,
+                                      bool counters) {
+  const int N = sizes.length();
+  const bool grouped = groups.length() > 0;
+  
+  if (grouped && groups.length() != N) Rcpp::stop("sizes and groups must be the same length");
+  if (!grouped) ngroups = 1;
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
   
-  // Retrieve circle positions and free memory
-  node = firstnode;
-  int i = 0;
-  while (node) {
-    xs[i] = node->x;
-    ys[i] = node->y;
-    radii[i] = node->radius;
-    node = node->insertnext;
-    i++;
+  // Indices of valid circles sorted by group, keeping input order within
+  // each group
+  std::vector<int> start(ngroups + 1, 0);
+  int nvalid = 0;
+  for (int i = 0; i < N; i++) {
+    if (valid_size(sizes[i])) {
+      int g = grouped ? groups[i] : 1;
+      if (g < 1 || g > ngroups) Rcpp::stop("invalid group code");
+      start[g]++ ;
+      nvalid++ ;
+    }
+  }
+  
+  if (nvalid == 0) Rcpp::stop("all sizes are missing and/or non-positive");
+  if (nvalid < N) Rcpp::warning("missing and/or non-positive sizes will be ignored");
+  
+  for (int g = 0; g < ngroups; g++) start[g + 1] += start[g];
+  
+  std::vector<int> order(nvalid);
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  for (int i = 0; i < N; i++) {
+    if (valid_size(sizes[i])) order[ fill[(grouped ? groups[i] : 1) - 1]++ ] = i;
   }
+  
+  NumericVector xs(N, NA_REAL);
+  NumericVector ys(N, NA_REAL);
+  NumericVector rs(N, NA_REAL);
+  
+  const double* psize = sizes.begin();
+  double* px = xs.begin();
+  double* py = ys.begin();
+  double* pr = rs.begin();
+  const int* pstart = &start[0];
+  const int* porder = &order[0];
+  
+  // Counts for each group, combined after the layout
+  std::vector<PlaceCounters> gcounts(counters ? ngroups : 0);
+  PlaceCounters* pcounts = counters ? &gcounts[0] : NULL;
 
-  node = firstnode;
-  while (node) {
-    Node *next = node->insertnext;
-    delete node;
-    node = next;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+  for (int g = 0; g < ngroups; g++) {
+    const int n = pstart[g + 1] - pstart[g];
+    const int* idx = porder + pstart[g];
+    
+    std::vector<double> gr(n);
+    for (int k = 0; k < n; k++) gr[k] = size_to_radius(psize[ idx[k] ], area);
+    
+    NodePool nodes(n > 0 ? &gr[0] : NULL, n);
+    place_circles(nodes, pcounts ? pcounts + g : NULL);
+    
+    for (int k = 0; k < n; k++) {
+      px[ idx[k] ] = nodes[k].x;
+      py[ idx[k] ] = nodes[k].y;
+      pr[ idx[k] ] = gr[k];
+    }
+  }
+  
+  DataFrame res = DataFrame::create(
+    Named("x") = xs,
+    Named("y") = ys,
+    Named("radius") = rs);
+  
+  if (counters) {
+    PlaceCounters total;
+    for (int g = 0; g < ngroups; g++) {
+      total.front_length += gcounts[g].front_length;
+      total.max_front_length = std::max(total.max_front_length, gcounts[g].max_front_length);
+      total.search_steps += gcounts[g].search_steps;
+      total.splices += gcounts[g].splices;
+    }
+    
+    res.attr("counters") = List::create(
+      Named("front_length") = total.front_length,
+      Named("max_front_length") = total.max_front_length,
+      Named("search_steps") = total.search_steps,
+      Named("splices") = total.splices );
   }
+  
+  return res;
+}
 
-  return DataFrame::create(
+
+// Gets the stream object from an external pointer, checking that it is 
+// still valid (e.g. it has not been restored from a saved workspace).
+ProgressiveStream* get_stream(SEXP stream) {
+  XPtr<ProgressiveStream> p(stream);
+  if (!p.get()) Rcpp::stop("Invalid layout stream (was it saved and reloaded?)");
+  return p.get();
+}
+
+
+// Creates a new, empty progressive layout stream. Returns an external 
+// pointer.
+//
+// [[Rcpp::export]]
+SEXP progressive_stream_new() {
+  XPtr<ProgressiveStream> p( new ProgressiveStream(), true );
+  return p;
+}
+
+
+// Places a chunk of circles in a progressive layout stream.
+//
+// @param sizes circle sizes. Circles with missing or non-positive sizes are
+//   ignored and will have missing values in the output.
+// @param area true if sizes are areas; false if they are radii.
+//
+// @return a data frame of positions and radii for the circles in the 
+//   chunk, in the same order as the input. Attributes "placed" and 
+//   "stored" give the total number of circles placed so far and the number
+//   of nodes held by the stream.
+//
+// [[Rcpp::export]]
+DataFrame progressive_stream_add(SEXP stream, NumericVector sizes, bool area) {
+  ProgressiveStream* p = get_stream(stream);
+  
+  const int N = sizes.length();
+  NumericVector xs(N);
+  NumericVector ys(N);
+  NumericVector rs(N);
+  
+  int placed = p->add(sizes.begin(), N, area, xs.begin(), ys.begin(), rs.begin());
+  if (placed < N) Rcpp::warning("missing and/or non-positive sizes will be ignored");
+  
+  DataFrame res = DataFrame::create(
     Named("x") = xs,
     Named("y") = ys,
-    Named("radius") = radii);
+    Named("radius") = rs);
+  
+  res.attr("placed") = p->size();
+  res.attr("stored") = p->stored();
+  
+  return res;
 }
 
+
+// Progressive layout of the circles in a layout file (see layout_file.h),
+// taking radii from the radius column and writing centres to the x and y 
+// columns in place. Circles are placed in chunks by a ProgressiveStream,
+// so memory use depends on the length of the front chain rather than the
+// number of circles. Circles with missing or non-positive radii are 
+// ignored and have missing values written.
+//
+// @return the number of circles placed.
+//
+// [[Rcpp::export]]
+double layout_file_progressive(std::string path) {
+  LayoutFile f(path, true);
+  ProgressiveStream stream;
+  
+  const int64_t n = f.size();
+  const int64_t chunk = 1 << 20;
+  
+  for (int64_t i = 0; i < n; i += chunk) {
+    const int m = (int) std::min(chunk, n - i);
+    stream.add(f.radius() + i, m, false, f.x() + i, f.y() + i, f.radius() + i);
+    Rcpp::checkUserInterrupt();
+  }
+  
+  if (stream.size() < n) Rcpp::warning("missing and/or non-positive sizes will be ignored");
+  
+  return stream.size();
+}
@@ -0,0 +1,127 @@
+/*
+ * Node storage for the progressive layout algorithm (pmenzel_circle_pack.cpp),
+ * shared with the nested layout functions (nested_layout.cpp).
+ */
+
+#ifndef PACKCIRCLES_PROGRESSIVE_LAYOUT_H
+#define PACKCIRCLES_PROGRESSIVE_LAYOUT_H
+
+#include <cstddef>
+#include <vector>
+
+const double INTERSECTION_TOL = 1.0e-4;
+
+// Index value for no node
+const int NO_NODE = -1;
+
+
+// Nodes are stored contiguously in a NodePool (below) and refer to each
+// other by index. The order of nodes in the pool is the order in which
+// circles are placed.
+//
+class Node {
+public:
+  Node() : radius(0.0), x(0.0), y(0.0), next(NO_NODE), prev(NO_NODE), onfront(false) {}
+  
+  // Check for intersection with another node
+  bool intersects(const Node& n) const {
+    double dx = x - n.x;
+    double dy = y - n.y;
+    double dr = radius + n.radius;
+    
+    return ((dr * dr - dx * dx - dy * dy) > INTERSECTION_TOL);
+  }
+
+  double radius;
+  double x;
+  double y;
+  
+  int next;
+  int prev;
+  
+  // Whether this node is currently part of the front chain
+  bool onfront;
+};
+
+
+class NodePool {
+public:
+  NodePool() {}
+  
+  NodePool(const double* radii, int n) : nodes(n) {
+    for (int i = 0; i < n; i++) nodes[i].radius = radii[i];
+  }
+  
+  Node& operator[](int i) { return nodes[i]; }
+  const Node& operator[](int i) const { return nodes[i]; }
+  
+  int size() const { return nodes.size(); }
+  
+  // Place node `c` after node `a`
+  void place_after(int c, int a) {
+    int n = nodes[a].next;
+    nodes[a].next = c;
+    nodes[c].prev = a;
+    nodes[c].next = n;
+    if (n != NO_NODE) nodes[n].prev = c;
+  }
+  
+  // Splice node `c` before node `a`
+  void splice(int c, int a) {
+    nodes[c].next = a;
+    nodes[a].prev = c;
+  }
+  
+  // Adds an unplaced node with the given radius. Returns its index.
+  int add(double radius) {
+    nodes.push_back(Node());
+    nodes.back().radius = radius;
+    return nodes.size() - 1;
+  }
+  
+  // Removes the nodes that are not on the front chain, keeping the others
+  // in order with their links updated. Returns the new index of each old
+  // node, or NO_NODE for removed nodes.
+  std::vector<int> keep_front() {
+    std::vector<int> newidx(nodes.size(), NO_NODE);
+    int k = 0;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+      if (nodes[i].onfront) newidx[i] = k++ ;
+    }
+    
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+      if (newidx[i] != NO_NODE) {
+        Node& n = nodes[ newidx[i] ];
+        n = nodes[i];
+        if (n.next != NO_NODE) n.next = newidx[n.next];
+        if (n.prev != NO_NODE) n.prev = newidx[n.prev];
+      }
+    }
+    
+    nodes.resize(k);
+    return newidx;
+  }
+  
+private:
+  std::vector<Node> nodes;
+};
+
+
+// Optional counters of the work done by place_circles.
+struct PlaceCounters {
+  PlaceCounters() : 
+    front_length(0), max_front_length(0), search_steps(0), splices(0) {}
+  
+  double front_length;      // nodes in the front chain when done
+  double max_front_length;  // largest number of nodes in the front chain
+  double search_steps;      // nodes tested in intersection searches
+  double splices;           // splices removing nodes from the front chain
+};
+
+
+// Places the circles in `nodes`, in order, around the origin. Only uses
+// standard library code so it is safe to call from worker threads.
+// If counters is not NULL, counts of the work done are added to it.
+void place_circles(NodePool& nodes, PlaceCounters* counters = NULL);
+
+#endif
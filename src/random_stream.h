@@ -0,0 +1,48 @@
+/*
+ * Small, fast random number generator (PCG32, O'Neill 2014) for use in 
+ * C++ code that may run on worker threads, where R's random number 
+ * generator cannot be called.
+ *
+ * Each generator is initialized from a seed and a stream number. 
+ * Generators with the same seed but different stream numbers give
+ * independent sequences, so the usual pattern is to draw one seed from 
+ * R's generator on the main thread (as Circles::seed_from_r does in
+ * select_non_overlapping.cpp) and give each unit of parallel work its
+ * own stream. Results are then reproducible with set.seed in R and do not
+ * depend on the number of threads.
+ */
+
+#ifndef PACKCIRCLES_RANDOM_STREAM_H
+#define PACKCIRCLES_RANDOM_STREAM_H
+
+#include <stdint.h>
+
+class RandomStream {
+public:
+  RandomStream(uint64_t seed, uint64_t stream) :
+    _state(0), _inc((stream << 1) | 1u) {
+    next();
+    _state += seed;
+    next();
+  }
+  
+  // Random 32-bit value
+  uint32_t next() {
+    uint64_t old = _state;
+    _state = old * 6364136223846793005ULL + _inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  }
+  
+  // Random integer from 0 to n-1
+  int nextInt(int n) {
+    return (int)(((uint64_t)next() * (uint64_t)n) >> 32);
+  }
+  
+private:
+  uint64_t _state;
+  uint64_t _inc;
+};
+
+#endif
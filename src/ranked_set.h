@@ -0,0 +1,167 @@
+/*
+ * Ordered set of items (integer IDs 0 to n-1) keyed by a numeric value,
+ * with ties ordered by ascending ID, supporting selection by rank.
+ *
+ * Used by the greedy overlap removal in select_non_overlapping.cpp to find
+ * the set of circles with the current minimum or maximum key and pick one
+ * of them by position, in O(log n) time per operation.
+ *
+ * Implemented as a treap stored in arrays indexed by item ID, so each item
+ * can be in the set at most once and no allocation is done after
+ * construction. Node priorities are a hash of the item ID rather than
+ * random values so that R's random number stream is not affected.
+ */
+
+#ifndef PACKCIRCLES_RANKED_SET_H
+#define PACKCIRCLES_RANKED_SET_H
+
+#include <vector>
+
+class RankedSet {
+public:
+  explicit RankedSet(int n) :
+    _key(n, 0.0), _pri(n), _left(n, NONE), _right(n, NONE), _size(n, 0),
+    _root(NONE) {
+
+    for (int i = 0; i < n; i++) _pri[i] = hash(i);
+  }
+
+
+  int size() const { return _root == NONE ? 0 : _size[_root]; }
+
+
+  // Adds an item, which must not already be in the set.
+  void insert(int id, double key) {
+    _key[id] = key;
+    _left[id] = _right[id] = NONE;
+    _size[id] = 1;
+
+    int lo, hi;
+    split(_root, _key[id], id, lo, hi);
+    _root = merge(merge(lo, id), hi);
+  }
+
+
+  // Removes an item, which must be in the set.
+  void erase(int id) {
+    _root = erase_from(_root, id);
+  }
+
+
+  // Smallest and largest keys. The set must not be empty.
+  double min_key() const {
+    int t = _root;
+    while (_left[t] != NONE) t = _left[t];
+    return _key[t];
+  }
+
+  double max_key() const {
+    int t = _root;
+    while (_right[t] != NONE) t = _right[t];
+    return _key[t];
+  }
+
+
+  // Number of items with key less than (or, if inclusive, equal to) `key`.
+  int count_below(double key, bool inclusive) const {
+    int n = 0;
+    int t = _root;
+    while (t != NONE) {
+      if (_key[t] < key || (inclusive && _key[t] == key)) {
+        n += 1 + sz(_left[t]);
+        t = _right[t];
+      } else {
+        t = _left[t];
+      }
+    }
+    return n;
+  }
+
+
+  // Returns the ID of the item at position k (0-based) in key order.
+  int select(int k) const {
+    int t = _root;
+    while (true) {
+      int nleft = sz(_left[t]);
+      if (k < nleft) {
+        t = _left[t];
+      } else if (k == nleft) {
+        return t;
+      } else {
+        k -= nleft + 1;
+        t = _right[t];
+      }
+    }
+  }
+
+
+private:
+  static const int NONE = -1;
+
+  static unsigned int hash(unsigned int x) {
+    x = ((x >> 16) ^ x) * 0x45d9f3bu;
+    x = ((x >> 16) ^ x) * 0x45d9f3bu;
+    return (x >> 16) ^ x;
+  }
+
+  int sz(int t) const { return t == NONE ? 0 : _size[t]; }
+
+  void update(int t) {
+    _size[t] = 1 + sz(_left[t]) + sz(_right[t]);
+  }
+
+  // Whether item t comes before (key, id) in the set order
+  bool before(int t, double key, int id) const {
+    return _key[t] < key || (_key[t] == key && t < id);
+  }
+
+  // Splits tree t into items before (key, id) and the rest
+  void split(int t, double key, int id, int& lo, int& hi) {
+    if (t == NONE) {
+      lo = hi = NONE;
+    } else if (before(t, key, id)) {
+      split(_right[t], key, id, _right[t], hi);
+      lo = t;
+      update(t);
+    } else {
+      split(_left[t], key, id, lo, _left[t]);
+      hi = t;
+      update(t);
+    }
+  }
+
+  // Joins trees a and b, where all items in a come before those in b
+  int merge(int a, int b) {
+    if (a == NONE) return b;
+    if (b == NONE) return a;
+
+    if (_pri[a] > _pri[b]) {
+      _right[a] = merge(_right[a], b);
+      update(a);
+      return a;
+    } else {
+      _left[b] = merge(a, _left[b]);
+      update(b);
+      return b;
+    }
+  }
+
+  int erase_from(int t, int id) {
+    if (t == id) return merge(_left[t], _right[t]);
+
+    if (before(t, _key[id], id)) _right[t] = erase_from(_right[t], id);
+    else _left[t] = erase_from(_left[t], id);
+
+    update(t);
+    return t;
+  }
+
+  std::vector<double> _key;
+  std::vector<unsigned int> _pri;
+  std::vector<int> _left;
+  std::vector<int> _right;
+  std::vector<int> _size;
+  int _root;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Declarations shared by the pair-repulsion layout functions in 
+ * packcircles.cpp and the persistent layout state in repel_state.cpp.
+ */
+
+#ifndef PACKCIRCLES_REPEL_LAYOUT_H
+#define PACKCIRCLES_REPEL_LAYOUT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class LayoutMonitor;  // layout_monitor.h
+
+
+// Circle data for the layout functions: raw pointers to circle centres, 
+// radii and weights stored as separate contiguous arrays (e.g. the columns
+// of the xyr matrix). This lets the inner loops avoid Rcpp accessors and 
+// makes it safe to read the data from worker threads.
+//
+// The layout can work with data of type double or, to halve the memory 
+// traffic of the pair loops, float (LayoutDataF).
+//
+// Two circles are only moved apart if they overlap by at least the 
+// tolerance: either overlap_tol, or overlap_tol times the smaller radius
+// if relative_tol is true.
+template <typename T>
+struct LayoutDataT {
+  LayoutDataT(T* x_, T* y_, const T* r_, const T* w_, int n_) :
+    x(x_), y(y_), r(r_), w(w_), n(n_), overlap_tol(1.0e-5), relative_tol(false) {}
+  
+  // Smallest overlap of circles i and j that will be resolved
+  double min_overlap(int i, int j) const {
+    return relative_tol ? overlap_tol * std::min(r[i], r[j]) : overlap_tol;
+  }
+    
+  T* x;
+  T* y;
+  const T* r;
+  const T* w;
+  int n;
+  
+  double overlap_tol;
+  bool relative_tol;
+};
+
+typedef LayoutDataT<double> LayoutData;
+typedef LayoutDataT<float> LayoutDataF;
+
+
+// Record of each iteration of a layout run.
+struct LayoutTrace {
+  std::vector<int> nactive;     // active circles at the start of the iteration
+  std::vector<double> overlap;  // total overlap of the pairs moved apart
+  std::vector<double> maxmove;  // largest distance a circle was moved
+};
+
+
+// Optional counters of the work done by the layout functions. Times are
+// in seconds.
+struct RepelCounters {
+  RepelCounters() : 
+    pairs_tested(0), pairs_moved(0), 
+    time_prepare(0), time_compare(0), time_update(0) {}
+  
+  double pairs_tested;   // pairs of circles tested for overlap
+  double pairs_moved;    // pairs of overlapping circles moved apart
+  double time_prepare;   // building grids and lists of active circles
+  double time_compare;   // testing and moving pairs of circles
+  double time_update;    // applying displacements (parallel version only)
+};
+
+
+// Runs up to maxiter iterations of the layout algorithm, stopping early if 
+// no circles move, or if the total overlap of the pairs moved apart in an
+// iteration is less than stopoverlap, or if no circle moves by as much as
+// stopmove in an iteration.
+// 
+// active   - flags for circles to compare in the first iteration; on return,
+//            flags for circles moved in the last iteration (all zero if the
+//            layout converged)
+// trace    - a record of each iteration is appended to this
+// counters - if not NULL, counts of the work done are added to this
+// monitor  - if not NULL, called after each iteration with the number of
+//            active circles at its start; the layout stops early if this 
+//            returns true
+//
+// Returns the number of iterations in which circles moved.
+//
+// Instantiated for LayoutData and LayoutDataF.
+template <typename T>
+int run_layout(LayoutDataT<T>& data, 
+               std::vector<char>& active,
+               int maxiter,
+               double xmin, double xmax, 
+               double ymin, double ymax,
+               bool wrap,
+               bool use_grid,
+               int nthreads,
+               LayoutTrace& trace,
+               double stopoverlap = 0.0,
+               double stopmove = 0.0,
+               RepelCounters* counters = NULL,
+               LayoutMonitor* monitor = NULL);
+
+
+// Checks a method name ("pairwise" or "grid") and returns true for "grid".
+bool use_grid_method(const std::string& method);
+
+#endif
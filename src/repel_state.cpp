@@ -0,0 +1,229 @@
+/*
+ * Persistent state for the pair-repulsion layout.
+ *
+ * Holds circle positions, sizes and weights between calls from R so that
+ * a layout can be updated as circles are added, removed or resized, and 
+ * then re-run from its current positions. Circles that are added or resized
+ * are flagged as active, so the next run only needs to compare pairs 
+ * involving them (see run_layout in packcircles.cpp) until the layout 
+ * settles again. Each iteration still rebuilds the grid and scans the
+ * flags for all circles, so its cost is O(N) even after a small change.
+ *
+ * Circles are identified by integer IDs assigned in order as they are added,
+ * starting from 1.
+ */
+
+#define STRICT_R_HEADERS
+#include <Rcpp.h>
+#include "circle_sizes.h"
+#include "repel_layout.h"
+
+#include <map>
+#include <vector>
+
+using namespace Rcpp;
+
+
+class RepelState {
+public:
+  RepelState(double xmin_, double xmax_, double ymin_, double ymax_,
+             bool wrap_, bool use_grid_, int nthreads_) :
+    xmin(xmin_), xmax(xmax_), ymin(ymin_), ymax(ymax_),
+    wrap(wrap_), use_grid(use_grid_), nthreads(nthreads_), nextid(1) {}
+  
+  
+  // Adds circles, skipping any with missing or non-positive size. Sizes
+  // are areas if area is true, otherwise radii. Returns the new circle IDs,
+  // with NA for skipped circles.
+  IntegerVector add(const NumericVector& xs, const NumericVector& ys,
+                    const NumericVector& sizes, bool area,
+                    const NumericVector& ws) {
+                      
+    const int n = sizes.length();
+    IntegerVector newids(n);
+    
+    for (int i = 0; i < n; i++) {
+      int id = nextid++ ;
+      
+      if (!valid_size(sizes[i])) {
+        newids[i] = NA_INTEGER;
+      } else {
+        index[id] = ids.size();
+        ids.push_back(id);
+        x.push_back(xs[i]);
+        y.push_back(ys[i]);
+        r.push_back(size_to_radius(sizes[i], area));
+        w.push_back(ws[i]);
+        active.push_back(1);
+        newids[i] = id;
+      }
+    }
+    
+    return newids;
+  }
+  
+  
+  // Removes circles. Removal cannot create new overlaps so no circles
+  // are made active.
+  void remove(const IntegerVector& delids) {
+    std::vector<char> keep(ids.size(), 1);
+    for (int i = 0; i < delids.length(); i++) keep[ lookup(delids[i]) ] = 0;
+    
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < ids.size(); i++) {
+      if (keep[i]) {
+        ids[k] = ids[i];
+        x[k] = x[i];
+        y[k] = y[i];
+        r[k] = r[i];
+        w[k] = w[i];
+        active[k] = active[i];
+        index[ids[k]] = k;
+        k++ ;
+      } else {
+        index.erase(ids[i]);
+      }
+    }
+    
+    ids.resize(k);
+    x.resize(k);
+    y.resize(k);
+    r.resize(k);
+    w.resize(k);
+    active.resize(k);
+  }
+  
+  
+  // Sets new radii for circles and flags them as active.
+  void resize(const IntegerVector& rids, const NumericVector& rs) {
+    for (int i = 0; i < rids.length(); i++) {
+      if (ISNAN(rs[i]) || rs[i] <= 0.0) Rcpp::stop("sizes must be positive");
+      
+      int k = lookup(rids[i]);
+      r[k] = rs[i];
+      active[k] = 1;
+    }
+  }
+  
+  
+  // Runs up to maxiter iterations of the layout from the current positions.
+  List step(int maxiter) {
+    const int n = ids.size();
+    LayoutTrace trace;
+    int niter = 0;
+    
+    if (n > 0 && maxiter > 0) {
+      LayoutData data(&x[0], &y[0], &r[0], &w[0], n);
+      niter = run_layout(data, active, maxiter, xmin, xmax, ymin, ymax,
+                         wrap, use_grid, nthreads, trace);
+    }
+    
+    return List::create(
+      _["niter"] = niter,
+      _["nactive"] = IntegerVector(trace.nactive.begin(), trace.nactive.end()) );
+  }
+  
+  
+  DataFrame layout() const {
+    return DataFrame::create(
+      Named("id") = IntegerVector(ids.begin(), ids.end()),
+      Named("x") = NumericVector(x.begin(), x.end()),
+      Named("y") = NumericVector(y.begin(), y.end()),
+      Named("radius") = NumericVector(r.begin(), r.end()) );
+  }
+  
+  
+private:
+  int lookup(int id) const {
+    std::map<int, int>::const_iterator it = index.find(id);
+    if (it == index.end()) {
+      Rcpp::stop("Unknown circle id: " + Rcpp::toString(id));
+    }
+    return it->second;
+  }
+  
+  double xmin, xmax, ymin, ymax;
+  bool wrap;
+  bool use_grid;
+  int nthreads;
+  
+  int nextid;
+  std::vector<int> ids;
+  std::map<int, int> index;   // circle ID to position in the vectors below
+  
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> r;
+  std::vector<double> w;
+  std::vector<char> active;
+};
+
+
+// Gets the state object from an external pointer, checking that it is
+// still valid (e.g. it has not been restored from a saved workspace).
+RepelState* get_state(SEXP state) {
+  XPtr<RepelState> p(state);
+  if (!p.get()) Rcpp::stop("Invalid layout state (was it saved and reloaded?)");
+  return p.get();
+}
+
+
+// Creates a new, empty layout state. Returns an external pointer.
+//
+// [[Rcpp::export]]
+SEXP repel_state_new(double xmin, double xmax, 
+                     double ymin, double ymax,
+                     bool wrap,
+                     std::string method,
+                     int nthreads) {
+                       
+  const bool use_grid = use_grid_method(method);
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+  
+  XPtr<RepelState> p( new RepelState(xmin, xmax, ymin, ymax, wrap, use_grid, nthreads), true );
+  return p;
+}
+
+
+// Adds circles to a layout state. Returns the new circle IDs.
+//
+// [[Rcpp::export]]
+IntegerVector repel_state_add(SEXP state, 
+                              NumericVector xs, NumericVector ys,
+                              NumericVector sizes, bool area,
+                              NumericVector ws) {
+  return get_state(state)->add(xs, ys, sizes, area, ws);
+}
+
+
+// Removes circles from a layout state.
+//
+// [[Rcpp::export]]
+void repel_state_remove(SEXP state, IntegerVector ids) {
+  get_state(state)->remove(ids);
+}
+
+
+// Sets new radii for circles in a layout state.
+//
+// [[Rcpp::export]]
+void repel_state_resize(SEXP state, IntegerVector ids, NumericVector rs) {
+  get_state(state)->resize(ids, rs);
+}
+
+
+// Runs up to maxiter iterations of the layout. Returns a list with
+// elements niter and nactive as for iterate_layout.
+//
+// [[Rcpp::export]]
+List repel_state_step(SEXP state, int maxiter) {
+  return get_state(state)->step(maxiter);
+}
+
+
+// Returns the current layout as a data frame with columns id, x, y, radius.
+//
+// [[Rcpp::export]]
+DataFrame repel_state_layout(SEXP state) {
+  return get_state(state)->layout();
+}
@@ -1,45 +1,21 @@
 #define STRICT_R_HEADERS
 #include <Rcpp.h>
+#include "cell_grid.h"
+#include "circle_index.h"
+#include "random_stream.h"
+#include "ranked_set.h"
 using namespace Rcpp;
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <vector>
-#include <float.h>
 
-using namespace std;
-
-// Class to generate random integers using 
-// R runif in the background.
-class RandomInts {
-public:
-  const static int NStore = 1000;
-  
-  RandomInts() {
-    store = runif(NStore);
-    pos = 0;
-  }
-  
-  int nextInt(int max) {
-    int r = (int)(store[pos] * (max + 1));
-    increment_pos();
-    return r;
-  }
-  
-private:
-  int pos;
-  NumericVector store;
-  
-  void increment_pos() {
-    pos += 1;
-    if (pos >= NStore) {
-      store = runif(NStore);
-      pos = 0;
-    }
-  }
-};
-
-RandomInts RANDOM;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+using namespace std;
 
 // State values for circles
 const int Selected = 1;
@@ -52,6 +28,14 @@ const StringVector OrderingLabels = StringVector::create(
   "maxov", "minov", "largest", "smallest", "random"
 );
 
+// Components of the overlap graph up to this size are solved exactly by 
+// select_exact
+const int MaxExactSize = 16;
+
+// Number of circles each thread takes at a time in select_circles_parallel
+const int Block = 256;
+
+
 enum OrderingCodes {
   ORDER_MAXOV,
   ORDER_MINOV,
@@ -66,7 +50,7 @@ public:
   Circle(double x_, double y_, double r_) : 
     x(x_), y(y_), radius(r_), state(Candidate) {}
   
-  bool intersects(const Circle& other, double tolerance) {
+  bool intersects(const Circle& other, double tolerance) const {
     double dx = x - other.x;
     double dy = y - other.y;
     double rsum = radius + other.radius;
@@ -83,180 +67,614 @@ public:
 
 class Circles {
 public:
-  Circles(NumericMatrix xyr, double tolerance) {
+  // If grid is not NULL, it is a grid over the same circles that is used
+  // to find overlaps if its cells are large enough (see find_neighbours).
+  Circles(NumericMatrix xyr, double tolerance, int nthreads, 
+          const CellGrid* grid = NULL) {
     const int N = xyr.nrow();
     
     for (int i = 0; i < N; i++) {
       _circles.push_back( Circle(xyr(i, 0), xyr(i, 1), xyr(i, 2)) );
-      _neighbours.push_back( vector<int>() );
     }
     
-    // Record overlaps for each circle in the initial configuration
-    for (int i = 0; i < N-1; i++) {
-      Circle& ci = _circles.at(i);
-      
-      for (int j = i+1; j < N; j++) {
-        Circle& cj = _circles.at(j);
-        
-        if (ci.intersects(cj, tolerance)) {
-          _neighbours.at(i).push_back(j);
-          _neighbours.at(j).push_back(i);
-        }
-      }
+    find_neighbours(tolerance, nthreads, grid);
+  }
+  
+  
+  // Finds a subset of non-overlapping circles.
+  //
+  // Circles with no overlaps are selected, and each connected component of
+  // the overlap graph is then processed separately (see 
+  // select_in_component). Since components do not interact, this gives the
+  // same result as processing all circles together, apart from the order
+  // in which random tie-breaking values are drawn.
+  //
+  // Components are processed in parallel. Each has its own random stream,
+  // based on a single seed drawn from R's generator, so the result does
+  // not depend on the number of threads.
+  //
+  LogicalVector select_circles(const int ordering, int nthreads) {
+    const int N = _circles.size();
+    
+    find_components();
+    
+    const int ncomp = ncomponents();
+    const uint64_t seed = seed_from_r();
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int c = 0; c < ncomp; c++) {
+      RandomStream rng(seed, c);
+      select_in_component(c, ordering, rng);
+    }
+     
+    LogicalVector sel(N, false);
+    for (int i = 0; i < N; i++) {
+      sel[i] = _circles.at(i).state == Selected;
     }
+    
+    return sel;
   }
   
   
-  // Finds a subset of non-overlapping circles
-  LogicalVector select_circles(const int ordering) {
+  // Finds a subset of non-overlapping circles in parallel rounds, rather
+  // than rejecting one circle at a time.
+  //
+  // Each circle with overlaps is given a fixed priority from the ordering
+  // (see priority_key), with ties broken by a random value and then by ID,
+  // and the circles are selected greedily in priority order: a circle is
+  // selected if no higher priority neighbour is selected. This is the
+  // lexicographically first maximal independent set of the overlap graph
+  // for that order. In each round, every undecided circle is rejected if a
+  // higher priority neighbour has been selected, or selected if all of its
+  // higher priority neighbours have been rejected, otherwise it waits for
+  // the next round.
+  //
+  // Circles are processed in parallel within each round, in blocks taken
+  // in priority order. The states are held in atomic flags that are 
+  // updated in place, so a circle sees the decisions already made for 
+  // higher priority circles in the same round, including those earlier in
+  // its own block. A circle only waits for a later round when a higher 
+  // priority neighbour is in a block still being processed by another
+  // thread. With one thread, every circle is decided in the first round.
+  // Since each decision only depends on the priority order, the result is
+  // the same for any number of threads. Circles are not divided into
+  // components, so a single large component is still spread across 
+  // threads.
+  //
+  // Each round only visits a window of 4 blocks per thread at the front
+  // of the undecided circles. The first block in the window is always
+  // settled, so there are at most N / Block rounds and the total work is
+  // at most about 4 * nthreads times that of a single pass.
+  //
+  LogicalVector select_circles_parallel(const int ordering, int nthreads) {
     const int N = _circles.size();
-    int ndone = 0;
+    const uint64_t seed = seed_from_r();
+    
+    vector<double> key(N);
+    vector<uint32_t> tie(N);
+    vector< std::atomic<int> > state(N);
+    vector<int> undecided;
+    
+    for (int i = 0; i < N; i++) {
+      const int nbrCount = _nbr_start[i + 1] - _nbr_start[i];
+      
+      if (nbrCount == 0) {
+        state[i].store(Selected, std::memory_order_relaxed);
+      }
+      else {
+        state[i].store(Candidate, std::memory_order_relaxed);
+        undecided.push_back(i);
+      }
+      
+      key[i] = priority_key(i, nbrCount, ordering);
+      tie[i] = RandomStream(seed, i).next();
+    }
     
-    while (ndone < N) {
-      IntegerVector nbrCount(N, 0);
-      for (int i = 0; i < N; i++) {
-        Circle& ci = _circles.at(i);
+    const double* pkey = key.empty() ? NULL : &key[0];
+    const uint32_t* ptie = tie.empty() ? NULL : &tie[0];
+    
+    // Whether circle j has a higher priority than circle i
+    auto before = [pkey, ptie](int j, int i) {
+      if (pkey[j] != pkey[i]) return pkey[j] < pkey[i];
+      if (ptie[j] != ptie[i]) return ptie[j] < ptie[i];
+      return j < i;
+    };
+    
+    // Highest priority first; compacting below keeps the order. Sorting
+    // copies of the keys is faster than sorting IDs with before().
+    {
+      vector< std::pair<std::pair<double, uint32_t>, int> > order(undecided.size());
+      for (unsigned int k = 0; k < undecided.size(); k++) {
+        const int i = undecided[k];
+        order[k] = std::make_pair(std::make_pair(pkey[i], ptie[i]), i);
+      }
+      std::sort(order.begin(), order.end());
+      for (unsigned int k = 0; k < order.size(); k++) undecided[k] = order[k].second;
+    }
+    
+    // Each round only visits a window at the front of the undecided list,
+    // so circles far down the order are not retried round after round.
+    const int nundecided = undecided.size();
+    const int window = 4 * Block * nthreads;
+    int head = 0;
+    
+    while (head < nundecided) {
+      const int end = std::min(head + window, nundecided);
+      const int* pu = &undecided[0];
+
+#ifdef _OPENMP
+      #pragma omp parallel for num_threads(nthreads) schedule(dynamic, Block)
+#endif
+      for (int k = head; k < end; k++) {
+        const int i = pu[k];
+        bool waiting = false;
+        bool rejected = false;
         
-        if (ci.state == Candidate) {
-          nbrCount[i] = count_neighbours(i);
+        for (int e = _nbr_start[i]; e < _nbr_start[i + 1]; e++) {
+          const int j = _nbrs[e];
+          if (!before(j, i)) continue;
           
-          if (nbrCount[i] == 0) {
-            ci.state = Selected;
-            ndone++ ;
+          const int sj = state[j].load(std::memory_order_relaxed);
+          if (sj == Selected) {
+            rejected = true;
+            break;
           }
+          if (sj == Candidate) waiting = true;
         }
+        
+        if (rejected) state[i].store(Rejected, std::memory_order_relaxed);
+        else if (!waiting) state[i].store(Selected, std::memory_order_relaxed);
       }
       
-      if (ndone < N) {
-        // Find circle(s) with current min or max number of overlaps,
-        // depending on the argument bigFirst, and randomly choose one
-        // for removal
-        LogicalVector b(nbrCount.length());
-        switch (ordering) {
-        case ORDER_MAXOV:
-          b = nbrCount == max(nbrCount); break;
-          
-        case ORDER_MINOV:
-        {
-          IntegerVector x = nbrCount[nbrCount > 0];
-          int val = min(x);
-          b = nbrCount == val;
+      // Move the circles still undecided to the end of the window, in
+      // order, so that they stay ahead of the circles after it
+      int m = end;
+      for (int k = end - 1; k >= head; k--) {
+        if (state[ pu[k] ].load(std::memory_order_relaxed) == Candidate) {
+          undecided[--m] = pu[k];
         }
-        break;
+      }
+      head = m;
+    }
+    
+    LogicalVector sel(N, false);
+    for (int i = 0; i < N; i++) {
+      _circles[i].state = state[i].load(std::memory_order_relaxed);
+      sel[i] = _circles[i].state == Selected;
+    }
+    
+    return sel;
+  }
+  
+  
+  // Finds a maximum weight subset of non-overlapping circles, by testing
+  // all subsets, for each component with at most MaxExactSize circles. 
+  // Components are processed in parallel. Circles in larger components are 
+  // left as candidates.
+  //
+  void select_exact(const NumericVector& weights, int nthreads) {
+    find_components();
+    
+    const int ncomp = ncomponents();
+    const double* w = weights.begin();
 
-        case ORDER_LARGEST:
-          b = flag_largest(nbrCount > 0); break;
-          
-        case ORDER_SMALLEST:
-          b = flag_smallest(nbrCount > 0); break;
-          
-        case ORDER_RANDOM:
-          b = nbrCount > 0; break;
-        }
-          
-        IntegerVector ids = which(b);
-        int removeId = sample_one_of(ids);
-        
-        _circles.at(removeId).state = Rejected;
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int c = 0; c < ncomp; c++) {
+      const int n = _comp_start[c + 1] - _comp_start[c];
+      if (n <= MaxExactSize) select_exact_in_component(c, w);
+    }
+  }
+  
+  
+  int ncomponents() const { return (int)_comp_start.size() - 1; }
+  
+  
+  // Returns the circles that are still candidates after select_exact, with
+  // their (1-based) component numbers and the overlapping pairs between
+  // them.
+  List unresolved() const {
+    const int N = _circles.size();
+    IntegerVector component(N, 0);
+    std::vector<int> from, to;
+    
+    int k = 0;
+    for (int c = 0; c < ncomponents(); c++) {
+      const int first = _comp_members[ _comp_start[c] ];
+      if (_circles[first].state != Candidate) continue;
+      
+      k++ ;
+      for (int m = _comp_start[c]; m < _comp_start[c + 1]; m++) {
+        const int i = _comp_members[m];
+        component[i] = k;
         
-        ndone++ ;
+        for (int e = _nbr_start[i]; e < _nbr_start[i + 1]; e++) {
+          if (_nbrs[e] > i) {
+            from.push_back(i + 1);
+            to.push_back(_nbrs[e] + 1);
+          }
+        }
       }
     }
-     
+    
     LogicalVector sel(N, false);
     for (int i = 0; i < N; i++) {
-      sel[i] = _circles.at(i).state == Selected;
+      sel[i] = _circles[i].state == Selected;
     }
     
-    return sel;
+    return List::create(
+      _["selected"] = sel,
+      _["component"] = component,
+      _["from"] = IntegerVector(from.begin(), from.end()),
+      _["to"] = IntegerVector(to.begin(), to.end()) );
   }
 
   
 private:    
-  // Count Candidate neighbours of circle id.
-  int count_neighbours(int id) {
-    int n = 0;
+  // Records overlaps for each circle in the initial configuration.
+  //
+  // A uniform grid is used to find candidate pairs: circles i and j can
+  // only intersect if their centres are closer than 
+  // (r_i + r_j) * sqrt(tolerance), so with a cell size of at least twice 
+  // the largest radius times sqrt(tolerance), each circle only needs to be
+  // compared with those in the same or adjacent cells. The neighbours of 
+  // each circle are found in two passes, first counting and then filling 
+  // the compressed adjacency arrays. Each pass can run in parallel since 
+  // every circle finds its own neighbours. As with a full pairwise search,
+  // the neighbours of each circle are in ascending order, so the result
+  // does not depend on the grid used.
+  //
+  // A prebuilt grid over the same circles (e.g. from a circle index) is
+  // used if its cells are large enough, otherwise a grid is built here.
+  //
+  void find_neighbours(double tolerance, int nthreads, const CellGrid* prebuilt) {
+    const int N = _circles.size();
+    _nbr_start.assign(N + 1, 0);
+    _nbrs.clear();
+    if (N < 2) return;
     
-    const vector<int>& nbrs = _neighbours.at(id);
+    vector<double> xs(N), ys(N);
+    double rmax = 0.0;
+    for (int i = 0; i < N; i++) {
+      xs[i] = _circles[i].x;
+      ys[i] = _circles[i].y;
+      if (_circles[i].radius > rmax) rmax = _circles[i].radius;
+    }
     
-    if (!nbrs.empty()) {
-      for (unsigned int k = 0; k < nbrs.size(); k++) {
-        int nbrId = nbrs.at(k);
-        if (_circles.at(nbrId).state == Candidate) n++ ;
-      }
+    // Cell size is increased slightly to allow for rounding error
+    const double cellsize = 2.0 * rmax * sqrt(tolerance) * (1.0 + 1e-9);
+    
+    CellGrid own;
+    if (!prebuilt || prebuilt->size() != N || prebuilt->cellsize() < cellsize) {
+      own.build(&xs[0], &ys[0], N, cellsize);
+      prebuilt = &own;
     }
+    const CellGrid& grid = *prebuilt;
     
-    return  n;
+    const Circle* pc = &_circles[0];
+    int* pstart = &_nbr_start[0];
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256)
+#endif
+    for (int i = 0; i < N; i++) {
+      int n = 0;
+      grid.for_each_near_item(i, [&](int j) {
+        if (j != i && pc[i].intersects(pc[j], tolerance)) n++ ;
+      });
+      pstart[i + 1] = n;
+    }
+    
+    for (int i = 0; i < N; i++) _nbr_start[i + 1] += _nbr_start[i];
+    _nbrs.resize(_nbr_start[N]);
+    
+    int* pnbrs = _nbrs.empty() ? NULL : &_nbrs[0];
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256)
+#endif
+    for (int i = 0; i < N; i++) {
+      int k = pstart[i];
+      grid.for_each_near_item(i, [&](int j) {
+        if (j != i && pc[i].intersects(pc[j], tolerance)) pnbrs[k++] = j;
+      });
+      std::sort(pnbrs + pstart[i], pnbrs + pstart[i + 1]);
+    }
   }
   
   
-  // helper function - returns a logical vector indicating which
-  // circles are included and largest amongst included
-  LogicalVector flag_largest(const LogicalVector& include) {
-    NumericVector radii(_circles.size(), 0.0);
-    for (unsigned int i = 0; i < _circles.size(); i++) {
-      if (include[i]) {
-        radii[i] = _circles.at(i).radius;
+  // Finds the connected components of the overlap graph. Circles with no
+  // overlaps are selected. Components are numbered in order of their 
+  // lowest circle ID, and the circles in each are stored in ascending order.
+  //
+  void find_components() {
+    const int N = _circles.size();
+    _comp_start.assign(1, 0);
+    _comp_members.clear();
+    _local.assign(N, 0);
+    
+    std::vector<char> seen(N, 0);
+    
+    for (int i = 0; i < N; i++) {
+      if (seen[i]) continue;
+      seen[i] = 1;
+      
+      if (_nbr_start[i] == _nbr_start[i + 1]) {
+        _circles[i].state = Selected;
+        continue;
+      }
+      
+      // Breadth-first search using the member array as the queue
+      const int first = _comp_members.size();
+      _comp_members.push_back(i);
+      for (unsigned int q = first; q < _comp_members.size(); q++) {
+        const int v = _comp_members[q];
+        for (int k = _nbr_start[v]; k < _nbr_start[v + 1]; k++) {
+          const int j = _nbrs[k];
+          if (!seen[j]) {
+            seen[j] = 1;
+            _comp_members.push_back(j);
+          }
+        }
+      }
+      
+      std::sort(_comp_members.begin() + first, _comp_members.end());
+      for (unsigned int q = first; q < _comp_members.size(); q++) {
+        _local[ _comp_members[q] ] = q - first;
       }
+      
+      _comp_start.push_back(_comp_members.size());
     }
+  }
+  
+  
+  // Heuristic selection within component c.
+  //
+  // Repeatedly selects all candidate circles with no candidate neighbours,
+  // then chooses one of the remaining candidates, according to the 
+  // ordering, to reject. Where several candidates rank equally, one is 
+  // chosen at random.
+  //
+  // Candidates are held in a RankedSet keyed by the ordering criterion,
+  // with ties in ascending ID order, and the number of candidate 
+  // neighbours of each circle is updated as circles are rejected. Each
+  // rejection therefore only does work for the rejected circle and its
+  // neighbours. (Selecting a circle never changes the count for another
+  // candidate, since a selected circle has no candidate neighbours.)
+  //
+  void select_in_component(int c, const int ordering, RandomStream& rng) {
+    const int* members = &_comp_members[ _comp_start[c] ];
+    const int n = _comp_start[c + 1] - _comp_start[c];
+    int ndone = 0;
+    
+    const bool count_keyed = ordering == ORDER_MAXOV || ordering == ORDER_MINOV;
+    const bool max_first = ordering == ORDER_MAXOV || ordering == ORDER_LARGEST;
     
-    return radii == max(radii);  
+    vector<int> nbrCount(n);
+    RankedSet candidates(n);
+    
+    for (int k = 0; k < n; k++) {
+      const int i = members[k];
+      nbrCount[k] = _nbr_start[i + 1] - _nbr_start[i];
+      candidates.insert(k, ordering_key(i, nbrCount[k], ordering));
+    }
+    
+    while (ndone < n) {
+      // Find the range of candidates with the current min or max key and
+      // randomly choose one for removal
+      int first, nties;
+      if (max_first) {
+        first = candidates.count_below(candidates.max_key(), false);
+        nties = candidates.size() - first;
+      }
+      else {
+        first = 0;
+        nties = candidates.count_below(candidates.min_key(), true);
+      }
+      
+      int removeLocal = candidates.select(first + (nties < 2 ? 0 : rng.nextInt(nties)));
+      int removeId = members[removeLocal];
+      
+      _circles[removeId].state = Rejected;
+      candidates.erase(removeLocal);
+      ndone++ ;
+      
+      for (int e = _nbr_start[removeId]; e < _nbr_start[removeId + 1]; e++) {
+        const int j = _nbrs[e];
+        if (_circles[j].state != Candidate) continue;
+        
+        const int kj = _local[j];
+        nbrCount[kj]-- ;
+        
+        if (nbrCount[kj] == 0) {
+          _circles[j].state = Selected;
+          candidates.erase(kj);
+          ndone++ ;
+        }
+        else if (count_keyed) {
+          candidates.erase(kj);
+          candidates.insert(kj, nbrCount[kj]);
+        }
+      }
+    }
   }
   
   
-  // helper function - returns a logical vector indicating which
-  // circles are included and largest amongst included
-  LogicalVector flag_smallest(const LogicalVector& include) {
-    NumericVector radii(_circles.size(), DBL_MAX);
-    for (unsigned int i = 0; i < _circles.size(); i++) {
-      if (include[i]) {
-        radii[i] = _circles.at(i).radius;
+  // Exact selection within component c: finds the subset of 
+  // non-overlapping circles with maximum total weight by depth-first search
+  // over include / exclude decisions, pruning branches that cannot beat the
+  // best subset found so far.
+  //
+  void select_exact_in_component(int c, const double* weights) {
+    const int* members = &_comp_members[ _comp_start[c] ];
+    const int n = _comp_start[c + 1] - _comp_start[c];
+    
+    ExactSearch search;
+    search.n = n;
+    search.best = -1.0;
+    search.bestset = 0;
+    
+    double total = 0.0;
+    for (int k = 0; k < n; k++) {
+      const int i = members[k];
+      search.w[k] = weights[i];
+      total += weights[i];
+      
+      search.adj[k] = 0;
+      for (int e = _nbr_start[i]; e < _nbr_start[i + 1]; e++) {
+        search.adj[k] |= 1u << _local[ _nbrs[e] ];
       }
     }
     
-    return radii == min(radii);
+    search.run(0, 0, 0, 0.0, total);
+    
+    for (int k = 0; k < n; k++) {
+      _circles[ members[k] ].state = (search.bestset >> k) & 1u ? Selected : Rejected;
+    }
+  }
+  
+  
+  struct ExactSearch {
+    int n;
+    double w[MaxExactSize];
+    unsigned int adj[MaxExactSize];
+    double best;
+    unsigned int bestset;
+    
+    // k - next circle to decide
+    // chosen - circles included so far
+    // blocked - circles that overlap an included circle
+    // sum - weight of included circles
+    // remaining - total weight of circles k to n-1
+    void run(int k, unsigned int chosen, unsigned int blocked, 
+             double sum, double remaining) {
+               
+      if (sum + remaining <= best) return;
+      
+      if (k == n) {
+        best = sum;
+        bestset = chosen;
+        return;
+      }
+      
+      const unsigned int bit = 1u << k;
+      remaining -= w[k];
+      
+      if (!(blocked & bit)) run(k + 1, chosen | bit, blocked | adj[k], sum + w[k], remaining);
+      run(k + 1, chosen, blocked, sum, remaining);
+    }
+  };
+  
+  
+  // Draws a 64-bit seed from R's random number generator.
+  static uint64_t seed_from_r() {
+    uint64_t hi = (uint64_t)(R::unif_rand() * 4294967296.0);
+    uint64_t lo = (uint64_t)(R::unif_rand() * 4294967296.0);
+    return (hi << 32) | lo;
   }
   
   
-  // helper function - gets indices of elements
-  // in a LogicalVector that are true
-  IntegerVector which(const LogicalVector& b) {
-    IntegerVector ii = Range(0, b.length() - 1);
-    return ii[b];
+  // Key for the candidate set: the number of candidate neighbours for
+  // orderings based on overlaps, or the radius for orderings based on size.
+  // For random ordering all candidates have the same key.
+  double ordering_key(int id, int nbrCount, int ordering) const {
+    switch (ordering) {
+    case ORDER_MAXOV:
+    case ORDER_MINOV:
+      return nbrCount;
+      
+    case ORDER_LARGEST:
+    case ORDER_SMALLEST:
+      return _circles[id].radius;
+      
+    default:
+      return 0.0;
+    }
   }
   
   
-  // helper function - select a random element
-  // from x
-  int sample_one_of(const IntegerVector& x) {
-    int n = x.length();
-    
-    if (n < 2) return x[0];
-    else {
-      int i = RANDOM.nextInt(n-1);
-      return x[i];
+  // Priority for select_circles_parallel, where circles with lower keys
+  // are selected first. Each ordering keeps the circles that the greedy
+  // version would reject last: those with the fewest overlaps for maxov,
+  // the most for minov, the smallest for largest and the largest for
+  // smallest. Overlap counts are those in the initial configuration. For 
+  // random ordering all circles have the same key.
+  double priority_key(int id, int nbrCount, int ordering) const {
+    switch (ordering) {
+    case ORDER_MAXOV:
+      return nbrCount;
+      
+    case ORDER_MINOV:
+      return -nbrCount;
+      
+    case ORDER_LARGEST:
+      return _circles[id].radius;
+      
+    case ORDER_SMALLEST:
+      return -_circles[id].radius;
+      
+    default:
+      return 0.0;
     }
   }
 
     
   vector<Circle> _circles;
-  vector< vector<int> > _neighbours;
+  
+  // Neighbours (overlapping circles) of circle i are 
+  // _nbrs[ _nbr_start[i] ] to _nbrs[ _nbr_start[i+1] - 1 ]
+  vector<int> _nbr_start;
+  vector<int> _nbrs;
+  
+  // Circles in component c (those with overlaps) are
+  // _comp_members[ _comp_start[c] ] to _comp_members[ _comp_start[c+1] - 1 ],
+  // and _local[i] is the position of circle i within its component.
+  vector<int> _comp_start;
+  vector<int> _comp_members;
+  vector<int> _local;
 };
 
 
 
+// Returns the grid of a circle index passed from R, or NULL if index is
+// NULL. The index must hold the same number of circles as xyr.
+//
+const CellGrid* index_grid(SEXP index, const NumericMatrix& xyr) {
+  if (index == R_NilValue) return NULL;
+  
+  const CircleIndex* p = get_circle_index(index);
+  if (p->size() != xyr.nrow()) Rcpp::stop("index does not match the circles");
+  return &p->grid();
+}
+
+
+
 // Function called from R.
 //
 // Takes a set of circles, each defined by centre xy coordinates
 // and radius, and iteratively selects those with no overlaps and
 // discards a random chosen one from those with the most overlaps.
 //
+// If parallel is true, the circles are selected in parallel rounds in
+// priority order (see Circles::select_circles_parallel) instead.
+//
+// If index is not NULL, it is a circle index holding the same circles as
+// xyr, in the same order, whose grid is used to find overlaps.
+//
 // Returns a logical vector with selected = true.
 //
 // [[Rcpp::export]]
 LogicalVector select_non_overlapping(NumericMatrix xyr, 
                                      const double tolerance, 
-                                     const StringVector& ordering) {
+                                     const StringVector& ordering,
+                                     const int nthreads,
+                                     const bool parallel,
+                                     SEXP index) {
+  
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
   
   int match = -1;
   try {
@@ -268,8 +686,9 @@ LogicalVector select_non_overlapping(NumericMatrix xyr,
     }
     
     if (match >= 0) {
-      Circles cs(xyr, tolerance);
-      return cs.select_circles(match);
+      Circles cs(xyr, tolerance, nthreads, index_grid(index, xyr));
+      if (parallel) return cs.select_circles_parallel(match, nthreads);
+      else return cs.select_circles(match, nthreads);
     }
     else throw std::invalid_argument("Invalid ordering argument");
     
@@ -280,3 +699,33 @@ LogicalVector select_non_overlapping(NumericMatrix xyr,
   return NA_LOGICAL;  // not reached
 }
 
+
+
+// Function called from R.
+//
+// Finds the connected components of the overlap graph for a set of 
+// circles. Circles with no overlaps are selected, and a maximum weight 
+// subset of non-overlapping circles is found exactly for each small 
+// component. Larger components are left for the caller to solve.
+//
+// Returns a list with elements: selected, a logical vector of circles 
+// selected so far; component, the component number (1, 2, ...) for each
+// circle in a larger component, or 0; and from and to, giving the indices
+// of overlapping pairs of circles in the larger components.
+//
+// index is NULL or a circle index as for select_non_overlapping.
+//
+// [[Rcpp::export]]
+List exact_non_overlapping(NumericMatrix xyr, 
+                           const double tolerance,
+                           NumericVector weights,
+                           const int nthreads,
+                           SEXP index) {
+                             
+  if (nthreads < 1) Rcpp::stop("nthreads must be at least 1");
+  if (weights.length() != xyr.nrow()) Rcpp::stop("weights must have one element per circle");
+  
+  Circles cs(xyr, tolerance, nthreads, index_grid(index, xyr));
+  cs.select_exact(weights, nthreads);
+  return cs.unresolved();
+}